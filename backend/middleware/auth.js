@@ -30,6 +30,24 @@ const authMiddleware = async (req, res, next) => {
   }
 };
 
+// Socket.io: gắn socket.data.admin nếu handshake có JWT hợp lệ (auth.token).
+// Socket không có token vẫn kết nối nhưng chỉ nhận broadcast, không gửi lệnh.
+const socketAuth = async (socket, next) => {
+  const token = socket.handshake.auth?.token;
+  if (token) {
+    try {
+      const decoded = jwt.verify(token, process.env.JWT_SECRET);
+      const admin = await Admin.findById(decoded.id).select('-password');
+      if (admin && admin.isActive) {
+        socket.data.admin = admin;
+      }
+    } catch (error) {
+      console.log(`[Socket.io] Invalid token from ${socket.id}`);
+    }
+  }
+  next();
+};
+
 // Middleware kiểm tra role admin
 const adminOnly = (req, res, next) => {
   if (req.admin?.role !== 'admin') {
@@ -38,4 +56,4 @@ const adminOnly = (req, res, next) => {
   next();
 };
 
-module.exports = { authMiddleware, adminOnly };
+module.exports = { authMiddleware, adminOnly, socketAuth };
@@ -39,6 +39,17 @@ const machineSchema = new mongoose.Schema({
     lastResetDate: { type: Date, default: Date.now }
   },
   
+  // Bộ đếm lưu trong NVS của ESP32 (gửi qua HEARTBEAT)
+  deviceCounters: {
+    cyclesNormal: { type: Number, default: 0 },
+    cyclesHeavy: { type: Number, default: 0 },
+    motorOnSec: { type: Number, default: 0 },
+    valveOnSec: { type: Number, default: 0 },
+    motorToggles: { type: Number, default: 0 },
+    valveToggles: { type: Number, default: 0 },
+    lastHeartbeat: { type: Date, default: null }
+  },
+  
   createdAt: {
     type: Date,
     default: Date.now
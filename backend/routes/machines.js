@@ -1,6 +1,7 @@
 const express = require('express');
 const router = express.Router();
 const Machine = require('../models/Machine');
+const MqttService = require('../services/mqttService');
 
 module.exports = (mqttService, io) => {
   
@@ -27,6 +28,31 @@ module.exports = (mqttService, io) => {
     }
   });
 
+  // Yêu cầu máy gửi status ngay
+  router.post('/:machineId/refresh', async (req, res) => {
+    try {
+      mqttService.sendCommand(req.params.machineId, 'GET_STATUS');
+      res.json({ message: 'Status requested' });
+    } catch (error) {
+      res.status(500).json({ error: error.message });
+    }
+  });
+
+  // Tăng tần suất status trong lúc xem chi tiết máy
+  router.post('/:machineId/watch', async (req, res) => {
+    try {
+      const { durationMs = 30000 } = req.body;
+      if (!MqttService.isValidMachineId(req.params.machineId) ||
+          !MqttService.isValidWatchDuration(durationMs)) {
+        return res.status(400).json({ error: 'Invalid machineId or durationMs' });
+      }
+      mqttService.watchMachine(req.params.machineId, durationMs);
+      res.json({ message: 'Fast status enabled', durationMs });
+    } catch (error) {
+      res.status(500).json({ error: error.message });
+    }
+  });
+
   // Gửi lệnh PAUSE
   router.post('/:machineId/pause', async (req, res) => {
     try {
@@ -150,7 +176,8 @@ module.exports = (mqttService, io) => {
         status: machine.status,
         totalCycles: machine.stats.totalCycles,
         todayCycles: machine.stats.todayCycles,
-        lastCycleAt: machine.stats.lastCycleAt
+        lastCycleAt: machine.stats.lastCycleAt,
+        deviceCounters: machine.deviceCounters
       });
     } catch (error) {
       res.status(500).json({ error: error.message });
@@ -9,7 +9,8 @@ const authRouter = require('./routes/auth');
 const ordersRouter = require('./routes/orders');
 const machinesRouter = require('./routes/machines');
 const notificationsRouter = require('./routes/notifications');
-const { authMiddleware } = require('./middleware/auth');
+const { authMiddleware, socketAuth } = require('./middleware/auth');
+const Machine = require('./models/Machine');
 
 const app = express();
 const server = http.createServer(app);
@@ -84,8 +85,17 @@ app.get('/api/health', (req, res) => {
 });
 
 // Socket.io connection handling
+io.use(socketAuth);
+
 io.on('connection', (socket) => {
-  console.log(`[Socket.io] Client connected: ${socket.id}`);
+  const admin = socket.data.admin;
+  console.log(`[Socket.io] Client connected: ${socket.id}${admin ? ` (admin ${admin.username})` : ''}`);
+  
+  // Dashboard vừa mở/reload -> lấy status mới ngay thay vì chờ chu kỳ.
+  // Chỉ admin đã đăng nhập: socket ẩn danh không được kích hoạt GET_STATUS cả fleet.
+  if (admin) {
+    mqttService.requestFleetStatus();
+  }
   
   socket.on('disconnect', () => {
     console.log(`[Socket.io] Client disconnected: ${socket.id}`);
@@ -93,10 +103,31 @@ io.on('connection', (socket) => {
   
   // Admin gửi lệnh qua socket
   socket.on('sendCommand', async (data) => {
-    const { machineId, command, payload } = data;
+    if (!admin) return;
+    const { machineId, command, payload } = data || {};
+    if (!MqttService.isValidMachineId(machineId) || typeof command !== 'string' || !command) {
+      console.log(`[Socket.io] Invalid sendCommand from ${socket.id}`);
+      return;
+    }
     console.log(`[Socket.io] Command from admin: ${command} to ${machineId}`);
     mqttService.sendCommand(machineId, command, payload);
   });
+  
+  // Admin đang xem chi tiết 1 máy (gửi lại định kỳ để gia hạn)
+  socket.on('watchMachine', async (data) => {
+    if (!admin) return;
+    const { machineId, durationMs = 30000 } = data || {};
+    if (!MqttService.isValidMachineId(machineId) || !MqttService.isValidWatchDuration(durationMs)) {
+      console.log(`[Socket.io] Invalid watchMachine from ${socket.id}`);
+      return;
+    }
+    try {
+      if (!(await Machine.exists({ _id: machineId }))) return;
+      mqttService.watchMachine(machineId, durationMs);
+    } catch (error) {
+      console.error('[Socket.io] watchMachine:', error.message);
+    }
+  });
 });
 
 // Error handling
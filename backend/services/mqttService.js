@@ -1,25 +1,52 @@
+const fs = require('fs');
 const mqtt = require('mqtt');
 const Order = require('../models/Order');
 const Machine = require('../models/Machine');
 const Notification = require('../models/Notification');
 const emailService = require('./emailService');
 
+// Trường trong counters của HEARTBEAT (xem publishHeartbeat() trong firmware)
+const HEARTBEAT_COUNTER_FIELDS = [
+  'cyclesNormal', 'cyclesHeavy', 'motorOnSec', 'valveOnSec', 'motorToggles', 'valveToggles'
+];
+
+// Khớp LAUNDRY_MACHINE_ID_MAX_LEN và MQTT_FAST_MAX_MS (include/): machineId đi
+// thẳng vào topic nên không được chứa '/', '+', '#'
+const MACHINE_ID_PATTERN = /^[A-Za-z0-9_-]{1,15}$/;
+const FAST_STATUS_MAX_MS = 120000;
+
 class MqttService {
   constructor(io) {
     this.io = io;
     this.client = null;
+    this.lastFleetStatusRequest = 0;
   }
 
   connect() {
-    this.client = mqtt.connect(process.env.MQTT_BROKER);
+    // Broker TLS riêng (mqtts://): CA tự ký, xem tools/mosquitto-tls
+    const options = {};
+    if (process.env.MQTT_CA_FILE) {
+      options.ca = fs.readFileSync(process.env.MQTT_CA_FILE);
+    }
+    this.client = mqtt.connect(process.env.MQTT_BROKER, options);
 
     this.client.on('connect', () => {
       console.log('✅ MQTT Connected to broker');
       
-      // Subscribe to all machine topics
-      this.client.subscribe('laundry/+/status');
-      this.client.subscribe('laundry/errors');
-      this.client.subscribe('laundry/events');
+      if (process.env.MQTT_GATEWAY === 'true') {
+        // Nhận snapshot đã gộp từ gateway (gateway/) thay vì từng message
+        this.client.subscribe('laundry/gateway/snapshot');
+        this.client.subscribe('laundry/gateway/errors');
+        this.client.subscribe('laundry/gateway/events');
+      } else {
+        // Subscribe to all machine topics
+        this.client.subscribe('laundry/+/status');
+        this.client.subscribe('laundry/errors');
+        this.client.subscribe('laundry/events');
+      }
+      
+      // Lấy trạng thái hiện tại của cả tiệm, không chờ chu kỳ publish tiếp theo
+      this.requestFleetStatus();
     });
 
     this.client.on('message', async (topic, message) => {
@@ -28,9 +55,11 @@ class MqttService {
         
         if (topic.includes('/status')) {
           await this.handleMachineStatus(data);
-        } else if (topic === 'laundry/errors') {
+        } else if (topic === 'laundry/gateway/snapshot') {
+          await this.handleSnapshot(data);
+        } else if (topic === 'laundry/errors' || topic === 'laundry/gateway/errors') {
           await this.handleError(data);
-        } else if (topic === 'laundry/events') {
+        } else if (topic === 'laundry/events' || topic === 'laundry/gateway/events') {
           await this.handleEvent(data);
         }
       } catch (error) {
@@ -58,12 +87,7 @@ class MqttService {
       });
     }
     
-    // Xác định status dựa trên state
-    let status = 'AVAILABLE';
-    if (state === 'POWER_OFF') status = 'OFFLINE';
-    else if (state === 'READY') status = 'AVAILABLE';
-    else if (state === 'ERROR_DOOR' || state === 'ERROR_WATER') status = 'ERROR';
-    else if (state !== 'DONE') status = 'RUNNING';
+    const status = this.stateToStatus(state);
     
     machine.status = status;
     machine.currentOrderCode = orderCode || null;
@@ -112,6 +136,92 @@ class MqttService {
     }
   }
 
+  // Xác định status dựa trên state
+  stateToStatus(state) {
+    if (state === 'POWER_OFF') return 'OFFLINE';
+    if (state === 'READY') return 'AVAILABLE';
+    if (state === 'ERROR_DOOR' || state === 'ERROR_WATER') return 'ERROR';
+    if (state !== 'DONE') return 'RUNNING';
+    return 'AVAILABLE';
+  }
+
+  // Xử lý snapshot từ gateway: 1 bulkWrite cho cả tiệm thay vì save() từng máy
+  async handleSnapshot(data) {
+    const machines = data.machines || [];
+    if (machines.length === 0) return;
+    
+    const now = new Date();
+    const machineOps = [];
+    const orderOps = [];
+    const updates = [];
+    
+    for (const m of machines) {
+      const { machineId, state, progress, waterLevel, mode, orderCode, doorOpen, errorCode } = m;
+      const status = this.stateToStatus(state);
+      const realtime = {
+        state,
+        progress,
+        waterLevel,
+        mode,
+        doorOpen,
+        errorCode: errorCode || null,
+        lastUpdate: now
+      };
+      
+      machineOps.push({
+        updateOne: {
+          filter: { _id: machineId },
+          update: {
+            $set: { status, currentOrderCode: orderCode || null, realtime },
+            $setOnInsert: { name: `Máy #${machineId.replace('MACHINE_', '')}` }
+          },
+          upsert: true
+        }
+      });
+      
+      if (orderCode) {
+        orderOps.push({
+          updateOne: {
+            filter: { orderCode },
+            update: {
+              status: state === 'DONE' ? 'DONE' : 'WASHING',
+              progress,
+              currentPhase: state,
+              mode,
+              machineId
+            }
+          }
+        });
+      }
+      
+      updates.push({ machineId, status, realtime, orderCode, progress, state, mode });
+    }
+    
+    await Machine.bulkWrite(machineOps, { ordered: false });
+    if (orderOps.length > 0) {
+      await Order.bulkWrite(orderOps, { ordered: false });
+    }
+    
+    // Emit to frontend via Socket.io (cùng format với handleMachineStatus)
+    for (const u of updates) {
+      this.io.emit('machineUpdate', {
+        machineId: u.machineId,
+        status: u.status,
+        realtime: u.realtime,
+        orderCode: u.orderCode
+      });
+      
+      if (u.orderCode) {
+        this.io.emit('orderUpdate', {
+          orderCode: u.orderCode,
+          progress: u.progress,
+          state: u.state,
+          mode: u.mode
+        });
+      }
+    }
+  }
+
   // Xử lý error từ máy giặt
   async handleError(data) {
     const { machineId, errorType, errorMessage, orderCode } = data;
@@ -146,7 +256,9 @@ class MqttService {
   async handleEvent(data) {
     const { machineId, event, orderCode, mode } = data;
     
-    console.log(`📢 Event from ${machineId}: ${event}`);
+    if (event !== 'HEARTBEAT') {
+      console.log(`📢 Event from ${machineId}: ${event}`);
+    }
     
     if (event === 'DONE' && orderCode) {
       // Cập nhật order
@@ -188,6 +300,20 @@ class MqttService {
       
       this.io.emit('machineOnline', { machineId });
     }
+    
+    if (event === 'HEARTBEAT' && data.counters) {
+      // Chỉ ghi trường có trong heartbeat: firmware cũ/thiếu trường không được
+      // xoá giá trị đã lưu (gán cả object deviceCounters sẽ ghi đè bằng undefined)
+      const update = { 'deviceCounters.lastHeartbeat': new Date() };
+      for (const field of HEARTBEAT_COUNTER_FIELDS) {
+        const value = data.counters[field];
+        if (Number.isFinite(value) && value >= 0) {
+          update[`deviceCounters.${field}`] = value;
+        }
+      }
+      
+      await Machine.findByIdAndUpdate(machineId, { $set: update });
+    }
   }
 
   // Gửi lệnh đến máy giặt
@@ -199,6 +325,31 @@ class MqttService {
     console.log(`📤 Command sent to ${machineId}: ${command}`);
   }
 
+  // Yêu cầu tất cả máy gửi status ngay (GET_STATUS qua topic broadcast)
+  requestFleetStatus() {
+    if (!this.isConnected()) return;
+    
+    // Nhiều dashboard mở cùng lúc chỉ tạo 1 yêu cầu
+    const now = Date.now();
+    if (now - this.lastFleetStatusRequest < 2000) return;
+    this.lastFleetStatusRequest = now;
+    
+    this.client.publish('laundry/all/command', JSON.stringify({ command: 'GET_STATUS' }));
+  }
+
+  static isValidMachineId(machineId) {
+    return typeof machineId === 'string' && MACHINE_ID_PATTERN.test(machineId);
+  }
+
+  static isValidWatchDuration(durationMs) {
+    return Number.isInteger(durationMs) && durationMs > 0 && durationMs <= FAST_STATUS_MAX_MS;
+  }
+
+  // Tăng tần suất status của 1 máy trong durationMs (gửi lại để gia hạn)
+  watchMachine(machineId, durationMs = 30000) {
+    this.sendCommand(machineId, 'SUBSCRIBE_FAST', { durationMs });
+  }
+
   // Kiểm tra kết nối MQTT
   isConnected() {
     return this.client && this.client.connected;
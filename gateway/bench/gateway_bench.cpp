@@ -0,0 +1,211 @@
+// ============================================
+// GATEWAY THROUGHPUT BENCHMARK
+//
+// In-process (không cần broker): đo tốc độ parse + gộp của MachineTable
+//   gateway-bench -x [-m machines] [-n messages]
+//
+// Qua broker local (chạy mosquitto + laundry-gateway trước):
+//   gateway-bench [-h host] [-p port] [-m machines] [-n messages] [-r rate]
+// Bắn status giả lập của m máy, đếm snapshot nhận về từ gateway.
+// ============================================
+#include <mosquitto.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "json_fields.h"
+#include "laundry_protocol.h"
+#include "machine_table.h"
+
+using Clock = std::chrono::steady_clock;
+
+struct BenchConfig {
+  std::string host = "localhost";
+  int port = 1883;
+  int machines = 100;
+  long messages = 100000;
+  long rate = 0;              // message/s, 0 = nhanh nhất có thể
+  bool inProcess = false;
+};
+
+struct SnapshotStats {
+  std::atomic<long> snapshots{0};
+  std::atomic<long> ingested{0};
+  std::atomic<long> machineRows{0};
+  std::atomic<int64_t> firstAtUs{0};
+  std::atomic<int64_t> lastAtUs{0};
+};
+
+static int64_t nowUs() {
+  using namespace std::chrono;
+  return duration_cast<microseconds>(Clock::now().time_since_epoch()).count();
+}
+
+// Giống payload publishStatus() trong src/main.cpp
+static int buildStatus(char* buf, size_t size, int machine, long seq) {
+  static const char* const modes[] = { "NORMAL", "HEAVY" };
+  State state = (State)(CHECK_SYSTEM + seq % (DONE - CHECK_SYSTEM));
+  return snprintf(buf, size,
+                  "{\"machineId\":\"MACHINE_%02d\",\"state\":\"%s\",\"progress\":%ld,"
+                  "\"waterLevel\":%ld,\"mode\":\"%s\",\"orderCode\":\"ORD%03d\","
+                  "\"doorOpen\":false,\"timestamp\":%ld}",
+                  machine, stateNames[state], seq % 101, (seq * 7) % 101,
+                  modes[machine & 1], machine, seq * 20);
+}
+
+static int runInProcess(const BenchConfig& config) {
+  std::vector<std::string> payloads;
+  char buf[256];
+  for (int m = 0; m < config.machines; m++) {
+    int n = buildStatus(buf, sizeof(buf), m + 1, m);
+    payloads.emplace_back(buf, n);
+  }
+
+  MachineTable table;
+  std::string snapshot;
+  size_t snapshotBytes = 0;
+  long snapshots = 0;
+  long perSnapshot = config.machines * 5;   // ~ 5 message/máy mỗi snapshot
+
+  int64_t start = nowUs();
+  for (long i = 0; i < config.messages; i++) {
+    const std::string& p = payloads[i % payloads.size()];
+    table.applyStatus(p.data(), p.size(), i);
+    if ((i + 1) % perSnapshot == 0) {
+      table.drainSnapshot(snapshot, "BENCH", i);
+      snapshotBytes += snapshot.size();
+      snapshots++;
+    }
+  }
+  double elapsed = (nowUs() - start) / 1e6;
+
+  printf("in-process: %ld status, %d machines, %.3f s\n", config.messages, config.machines, elapsed);
+  printf("  throughput      %.0f msg/s (%.2f us/msg)\n",
+         config.messages / elapsed, elapsed * 1e6 / config.messages);
+  printf("  snapshots       %ld (avg %.0f bytes)\n", snapshots,
+         snapshots ? (double)snapshotBytes / snapshots : 0.0);
+  printf("  rejected        %llu\n", (unsigned long long)table.rejected());
+  return table.rejected() == 0 ? 0 : 1;
+}
+
+static void onSnapshot(struct mosquitto*, void* obj, const struct mosquitto_message* msg) {
+  SnapshotStats* stats = static_cast<SnapshotStats*>(obj);
+
+  FlatJsonReader reader(static_cast<const char*>(msg->payload), msg->payloadlen);
+  JsonField f;
+  while (reader.next(f)) {
+    if (f.keyIs("ingested")) stats->ingested += f.asLong();
+    else if (f.keyIs("machineCount")) stats->machineRows += f.asLong();
+  }
+
+  int64_t now = nowUs();
+  int64_t expected = 0;
+  stats->firstAtUs.compare_exchange_strong(expected, now);
+  stats->lastAtUs = now;
+  stats->snapshots++;
+}
+
+static int runBroker(const BenchConfig& config) {
+  mosquitto_lib_init();
+  SnapshotStats stats;
+
+  struct mosquitto* sub = mosquitto_new("gateway_bench_sub", true, &stats);
+  struct mosquitto* pub = mosquitto_new("gateway_bench_pub", true, nullptr);
+  mosquitto_message_callback_set(sub, onSnapshot);
+  if (mosquitto_connect(sub, config.host.c_str(), config.port, 30) != MOSQ_ERR_SUCCESS ||
+      mosquitto_connect(pub, config.host.c_str(), config.port, 30) != MOSQ_ERR_SUCCESS) {
+    fprintf(stderr, "Cannot connect to %s:%d\n", config.host.c_str(), config.port);
+    return 1;
+  }
+  mosquitto_subscribe(sub, nullptr, LAUNDRY_TOPIC_GW_SNAPSHOT, 0);
+  mosquitto_loop_start(sub);
+  mosquitto_loop_start(pub);
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+  std::vector<std::string> topics;
+  for (int m = 1; m <= config.machines; m++) {
+    char topic[64];
+    snprintf(topic, sizeof(topic), "laundry/MACHINE_%02d/status", m);
+    topics.emplace_back(topic);
+  }
+
+  char buf[256];
+  int64_t start = nowUs();
+  for (long i = 0; i < config.messages; i++) {
+    int m = i % config.machines;
+    int n = buildStatus(buf, sizeof(buf), m + 1, i / config.machines);
+    mosquitto_publish(pub, nullptr, topics[m].c_str(), n, buf, 0, false);
+
+    if (config.rate > 0) {
+      int64_t due = start + (int64_t)(i + 1) * 1000000 / config.rate;
+      int64_t wait = due - nowUs();
+      if (wait > 0) std::this_thread::sleep_for(std::chrono::microseconds(wait));
+    }
+  }
+  double publishSec = (nowUs() - start) / 1e6;
+
+  // Chờ gateway xả hết (dừng khi ingested đủ hoặc 5s không có snapshot mới)
+  long lastSeen = -1;
+  int idleRounds = 0;
+  while (stats.ingested < config.messages && idleRounds < 10) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    long seen = stats.snapshots;
+    idleRounds = (seen == lastSeen) ? idleRounds + 1 : 0;
+    lastSeen = seen;
+  }
+  double gatewaySec = (stats.lastAtUs - start) / 1e6;
+
+  long ingested = stats.ingested;
+  long snapshots = stats.snapshots;
+  printf("broker %s:%d: %ld status, %d machines\n", config.host.c_str(), config.port,
+         config.messages, config.machines);
+  printf("  publish rate    %.0f msg/s\n", config.messages / publishSec);
+  printf("  gateway rate    %.0f msg/s (first status -> last snapshot)\n",
+         gatewaySec > 0 ? ingested / gatewaySec : 0.0);
+  printf("  ingested        %ld (%.2f%% lost)\n", ingested,
+         100.0 * (config.messages - ingested) / config.messages);
+  printf("  snapshots       %ld, %ld machine rows\n", snapshots, (long)stats.machineRows);
+  printf("  upstream msgs   %.1fx fewer than direct\n",
+         snapshots ? (double)config.messages / snapshots : 0.0);
+
+  mosquitto_disconnect(pub);
+  mosquitto_disconnect(sub);
+  mosquitto_loop_stop(pub, false);
+  mosquitto_loop_stop(sub, false);
+  mosquitto_destroy(pub);
+  mosquitto_destroy(sub);
+  mosquitto_lib_cleanup();
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  BenchConfig config;
+  int opt;
+  while ((opt = getopt(argc, argv, "h:p:m:n:r:x")) != -1) {
+    switch (opt) {
+      case 'h': config.host = optarg; break;
+      case 'p': config.port = atoi(optarg); break;
+      case 'm': config.machines = atoi(optarg); break;
+      case 'n': config.messages = atol(optarg); break;
+      case 'r': config.rate = atol(optarg); break;
+      case 'x': config.inProcess = true; break;
+      default:
+        fprintf(stderr, "Usage: %s [-x] [-h host] [-p port] [-m machines] [-n messages] [-r rate]\n",
+                argv[0]);
+        return 1;
+    }
+  }
+  if (config.machines < 1 || config.messages < 1) {
+    fprintf(stderr, "machines and messages must be >= 1\n");
+    return 1;
+  }
+
+  return config.inProcess ? runInProcess(config) : runBroker(config);
+}
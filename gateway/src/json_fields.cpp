@@ -0,0 +1,192 @@
+#include "json_fields.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+bool JsonField::keyIs(const char* name) const {
+  return strlen(name) == keyLen && memcmp(key, name, keyLen) == 0;
+}
+
+bool JsonField::valueIs(const char* literal) const {
+  return strlen(literal) == valueLen && memcmp(value, literal, valueLen) == 0;
+}
+
+bool JsonField::isNull() const {
+  return !isString && valueIs("null");
+}
+
+bool JsonField::asBool() const {
+  return !isString && valueIs("true");
+}
+
+long JsonField::asLong() const {
+  if (isString || valueLen == 0) return 0;
+  char buf[24];
+  size_t n = valueLen < sizeof(buf) - 1 ? valueLen : sizeof(buf) - 1;
+  memcpy(buf, value, n);
+  buf[n] = '\0';
+  return strtol(buf, nullptr, 10);
+}
+
+bool JsonField::copyString(char* out, size_t outSize) const {
+  if (!isString || outSize == 0) return false;
+  // Firmware không escape các trường này; bỏ qua để snapshot luôn là JSON hợp lệ
+  if (memchr(value, '\\', valueLen)) return false;
+  size_t n = valueLen < outSize - 1 ? valueLen : outSize - 1;
+  memcpy(out, value, n);
+  out[n] = '\0';
+  return true;
+}
+
+FlatJsonReader::FlatJsonReader(const char* json, size_t len)
+    : pos_(json), end_(json + len), started_(false), done_(false), failed_(false) {}
+
+void FlatJsonReader::skipSpace() {
+  while (pos_ < end_ && (*pos_ == ' ' || *pos_ == '\t' || *pos_ == '\r' || *pos_ == '\n')) {
+    pos_++;
+  }
+}
+
+bool FlatJsonReader::readString(const char** start, size_t* len) {
+  if (pos_ >= end_ || *pos_ != '"') return false;
+  const char* s = ++pos_;
+  while (pos_ < end_ && *pos_ != '"') {
+    if (*pos_ == '\\') pos_++;
+    pos_++;
+  }
+  if (pos_ >= end_) return false;
+  *start = s;
+  *len = pos_ - s;
+  pos_++;
+  return true;
+}
+
+// Bỏ qua nguyên 1 object/array lồng nhau, pos_ đang ở '{' hoặc '['
+bool FlatJsonReader::skipNested() {
+  int depth = 0;
+  while (pos_ < end_) {
+    char c = *pos_;
+    if (c == '"') {
+      const char* s;
+      size_t n;
+      if (!readString(&s, &n)) return false;
+      continue;
+    }
+    pos_++;
+    if (c == '{' || c == '[') {
+      depth++;
+    } else if (c == '}' || c == ']') {
+      if (--depth == 0) return true;
+    }
+  }
+  return false;
+}
+
+static bool isLiteralChar(char c) {
+  return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || c == '-' || c == '+' ||
+         c == '.' || c == 'E';
+}
+
+// Số JSON: -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?
+static bool isNumber(const char* p, const char* end) {
+  if (p < end && *p == '-') p++;
+  if (p >= end || *p < '0' || *p > '9') return false;
+  if (*p == '0') {
+    p++;
+  } else {
+    while (p < end && *p >= '0' && *p <= '9') p++;
+  }
+  if (p < end && *p == '.') {
+    p++;
+    if (p >= end || *p < '0' || *p > '9') return false;
+    while (p < end && *p >= '0' && *p <= '9') p++;
+  }
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    p++;
+    if (p < end && (*p == '+' || *p == '-')) p++;
+    if (p >= end || *p < '0' || *p > '9') return false;
+    while (p < end && *p >= '0' && *p <= '9') p++;
+  }
+  return p == end;
+}
+
+// Số hoặc true/false/null; chuỗi rỗng (vd. {"progress": }) không hợp lệ
+bool FlatJsonReader::readLiteral(const char** start, size_t* len) {
+  const char* s = pos_;
+  while (pos_ < end_ && isLiteralChar(*pos_)) pos_++;
+  size_t n = pos_ - s;
+  if (n == 0) return false;
+  if (!isNumber(s, pos_) &&
+      !(n == 4 && memcmp(s, "true", 4) == 0) &&
+      !(n == 5 && memcmp(s, "false", 5) == 0) &&
+      !(n == 4 && memcmp(s, "null", 4) == 0)) {
+    return false;
+  }
+  *start = s;
+  *len = n;
+  return true;
+}
+
+bool FlatJsonReader::next(JsonField& field) {
+  if (failed_ || done_) return false;
+
+  skipSpace();
+  if (!started_) {
+    if (pos_ >= end_ || *pos_ != '{') {
+      failed_ = true;
+      return false;
+    }
+    started_ = true;
+    pos_++;
+    skipSpace();
+    // Object rỗng: '}' ngay sau '{'
+    if (pos_ < end_ && *pos_ == '}') {
+      done_ = true;
+      return false;
+    }
+  } else if (pos_ < end_ && *pos_ == '}') {
+    done_ = true;
+    return false;
+  } else {
+    // Sau mỗi trường chỉ còn ',' (next() trước đã kiểm tra), phải có key tiếp theo
+    pos_++;
+    skipSpace();
+  }
+
+  if (!readString(&field.key, &field.keyLen)) {
+    failed_ = true;   // Bao gồm dấu phẩy thừa trước '}'
+    return false;
+  }
+  skipSpace();
+  if (pos_ >= end_ || *pos_ != ':') {
+    failed_ = true;
+    return false;
+  }
+  pos_++;
+  skipSpace();
+
+  bool ok;
+  if (pos_ < end_ && *pos_ == '"') {
+    field.isString = true;
+    ok = readString(&field.value, &field.valueLen);
+  } else if (pos_ < end_ && (*pos_ == '{' || *pos_ == '[')) {
+    field.isString = false;
+    field.value = pos_;
+    ok = skipNested();
+    field.valueLen = pos_ - field.value;
+  } else {
+    field.isString = false;
+    ok = readLiteral(&field.value, &field.valueLen);
+  }
+  if (!ok) {
+    failed_ = true;
+    return false;
+  }
+
+  skipSpace();
+  if (pos_ >= end_ || (*pos_ != ',' && *pos_ != '}')) {
+    failed_ = true;
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,51 @@
+// ============================================
+// FLAT JSON READER
+// Đọc các trường cấp ngoài cùng của message JSON từ firmware, không cấp phát.
+// Object/array lồng nhau được bỏ qua nguyên khối. Giá trị rỗng, literal lạ
+// (không phải số/true/false/null) và dấu phẩy thừa đều làm reader failed().
+// ============================================
+#ifndef GATEWAY_JSON_FIELDS_H
+#define GATEWAY_JSON_FIELDS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct JsonField {
+  const char* key;
+  size_t keyLen;
+  const char* value;     // Với string: phần bên trong dấu nháy, chưa unescape
+  size_t valueLen;
+  bool isString;
+
+  bool keyIs(const char* name) const;
+  bool valueIs(const char* literal) const;
+  bool isNull() const;
+  bool asBool() const;
+  long asLong() const;
+  // Copy chuỗi vào out (cắt bớt nếu dài), trả về false nếu không phải string
+  // hoặc chuỗi có escape
+  bool copyString(char* out, size_t outSize) const;
+};
+
+class FlatJsonReader {
+ public:
+  FlatJsonReader(const char* json, size_t len);
+
+  // Đọc trường kế tiếp; trả về false khi hết object hoặc JSON không hợp lệ
+  bool next(JsonField& field);
+  bool failed() const { return failed_; }
+
+ private:
+  void skipSpace();
+  bool readString(const char** start, size_t* len);
+  bool skipNested();
+  bool readLiteral(const char** start, size_t* len);
+
+  const char* pos_;
+  const char* end_;
+  bool started_;
+  bool done_;
+  bool failed_;
+};
+
+#endif
@@ -0,0 +1,140 @@
+#include "machine_table.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "json_fields.h"
+
+MachineSlot& MachineTable::slotFor(const char* machineId) {
+  auto it = index_.find(machineId);
+  if (it != index_.end()) return slots_[it->second];
+
+  MachineSlot slot = {};
+  strncpy(slot.machineId, machineId, sizeof(slot.machineId) - 1);
+  slot.state = -1;
+  index_.emplace(machineId, slots_.size());
+  slots_.push_back(slot);
+  return slots_.back();
+}
+
+// Số nguyên trong [0, 100]; trả về false nếu trường không phải số
+static bool readPercent(const JsonField& f, uint8_t* out) {
+  if (f.isString || f.isNull() || f.valueIs("true") || f.valueIs("false")) return false;
+  long v = f.asLong();
+  *out = v < 0 ? 0 : (v > 100 ? 100 : v);
+  return true;
+}
+
+// Chỉ các trường có mặt (và đúng kiểu) mới ghi đè slot: message thiếu trường
+// không được xoá orderCode/progress đang có trong snapshot
+bool MachineTable::applyStatus(const char* payload, size_t len, uint64_t nowMs) {
+  char machineId[LAUNDRY_MACHINE_ID_MAX_LEN + 1] = "";
+  char orderCode[LAUNDRY_ORDER_CODE_MAX_LEN + 1] = "";
+  char mode[LAUNDRY_MODE_MAX_LEN + 1] = "";
+  char errorCode[LAUNDRY_ERROR_CODE_MAX_LEN + 1] = "";
+  char stateName[16] = "";
+  uint8_t progress = 0;
+  uint8_t waterLevel = 0;
+  uint32_t timestamp = 0;
+  bool doorOpen = false;
+  bool hasOrderCode = false, hasMode = false, hasErrorCode = false, clearErrorCode = false;
+  bool hasProgress = false, hasWaterLevel = false, hasTimestamp = false, hasDoorOpen = false;
+
+  FlatJsonReader reader(payload, len);
+  JsonField f;
+  while (reader.next(f)) {
+    if (f.keyIs("machineId")) {
+      f.copyString(machineId, sizeof(machineId));
+    } else if (f.keyIs("state")) {
+      f.copyString(stateName, sizeof(stateName));
+    } else if (f.keyIs("progress")) {
+      hasProgress = readPercent(f, &progress);
+    } else if (f.keyIs("waterLevel")) {
+      hasWaterLevel = readPercent(f, &waterLevel);
+    } else if (f.keyIs("mode")) {
+      hasMode = f.copyString(mode, sizeof(mode));
+    } else if (f.keyIs("orderCode")) {
+      hasOrderCode = f.copyString(orderCode, sizeof(orderCode));
+    } else if (f.keyIs("doorOpen")) {
+      hasDoorOpen = f.valueIs("true") || f.valueIs("false");
+      doorOpen = f.asBool();
+    } else if (f.keyIs("timestamp")) {
+      hasTimestamp = !f.isString && !f.isNull();
+      timestamp = (uint32_t)f.asLong();
+    } else if (f.keyIs("errorCode")) {
+      clearErrorCode = f.isNull();
+      hasErrorCode = f.copyString(errorCode, sizeof(errorCode));
+    }
+  }
+
+  int state = stateFromName(stateName);
+  if (reader.failed() || machineId[0] == '\0' || state < 0) {
+    rejected_++;
+    return false;
+  }
+  // Firmware bỏ errorCode khi không có lỗi: rời trạng thái lỗi thì xoá mã cũ
+  if (!hasErrorCode && state != ERROR_DOOR && state != ERROR_WATER) clearErrorCode = true;
+
+  MachineSlot& slot = slotFor(machineId);
+  slot.state = state;
+  if (hasOrderCode) memcpy(slot.orderCode, orderCode, sizeof(orderCode));
+  if (hasMode) memcpy(slot.mode, mode, sizeof(mode));
+  if (hasErrorCode) memcpy(slot.errorCode, errorCode, sizeof(errorCode));
+  else if (clearErrorCode) slot.errorCode[0] = '\0';
+  if (hasProgress) slot.progress = progress;
+  if (hasWaterLevel) slot.waterLevel = waterLevel;
+  if (hasDoorOpen) slot.doorOpen = doorOpen;
+  if (hasTimestamp) slot.deviceTimestamp = timestamp;
+  slot.receivedAtMs = nowMs;
+  slot.updates++;
+  slot.dirty = true;
+
+  ingested_++;
+  ingestedSinceDrain_++;
+  return true;
+}
+
+size_t MachineTable::drainSnapshot(std::string& out, const char* gatewayId, uint64_t nowMs) {
+  out.clear();
+
+  size_t count = 0;
+  char buf[320];
+  for (MachineSlot& slot : slots_) {
+    if (!slot.dirty) continue;
+
+    int n = snprintf(buf, sizeof(buf),
+                     "%s{\"machineId\":\"%s\",\"state\":\"%s\",\"progress\":%u,"
+                     "\"waterLevel\":%u,\"mode\":\"%s\",\"orderCode\":\"%s\","
+                     "\"doorOpen\":%s,\"errorCode\":%s%s%s,\"timestamp\":%u,"
+                     "\"ageMs\":%llu,\"updates\":%u}",
+                     count ? "," : "",
+                     slot.machineId, stateNames[slot.state], slot.progress,
+                     slot.waterLevel, slot.mode, slot.orderCode,
+                     slot.doorOpen ? "true" : "false",
+                     slot.errorCode[0] ? "\"" : "null",
+                     slot.errorCode,
+                     slot.errorCode[0] ? "\"" : "",
+                     slot.deviceTimestamp,
+                     (unsigned long long)(nowMs - slot.receivedAtMs),
+                     slot.updates);
+    if (count == 0) {
+      out.reserve(64 + (size_t)n * slots_.size());
+      out += "{\"gatewayId\":\"";
+      out += gatewayId;
+      out += "\",\"machines\":[";
+    }
+    out.append(buf, n);
+
+    slot.dirty = false;
+    slot.updates = 0;
+    count++;
+  }
+
+  if (count == 0) return 0;
+
+  int n = snprintf(buf, sizeof(buf), "],\"machineCount\":%zu,\"ingested\":%llu,\"timestamp\":%llu}",
+                   count, (unsigned long long)ingestedSinceDrain_, (unsigned long long)nowMs);
+  out.append(buf, n);
+  ingestedSinceDrain_ = 0;
+  return count;
+}
@@ -0,0 +1,58 @@
+// ============================================
+// MACHINE TABLE
+// Bảng phẳng giữ trạng thái mới nhất của từng máy. Mỗi status message ghi đè
+// slot của máy đó; drainSnapshot() gom các slot đã đổi thành 1 message duy nhất.
+// Không thread-safe: gateway bọc bằng mutex.
+// ============================================
+#ifndef GATEWAY_MACHINE_TABLE_H
+#define GATEWAY_MACHINE_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "laundry_protocol.h"
+
+struct MachineSlot {
+  char machineId[LAUNDRY_MACHINE_ID_MAX_LEN + 1];
+  char orderCode[LAUNDRY_ORDER_CODE_MAX_LEN + 1];
+  char mode[LAUNDRY_MODE_MAX_LEN + 1];
+  char errorCode[LAUNDRY_ERROR_CODE_MAX_LEN + 1];
+  int8_t state;               // -1 = chưa biết
+  uint8_t progress;
+  uint8_t waterLevel;
+  bool doorOpen;
+  uint32_t deviceTimestamp;   // millis() trên máy giặt
+  uint64_t receivedAtMs;
+  uint32_t updates;           // Số message gộp lại kể từ snapshot trước
+  bool dirty;
+};
+
+class MachineTable {
+ public:
+  // Trả về false nếu payload không phải status message hợp lệ. Chỉ ghi đè các
+  // trường có trong message; errorCode bị xoá khi máy rời trạng thái lỗi.
+  bool applyStatus(const char* payload, size_t len, uint64_t nowMs);
+
+  // Ghi JSON của các máy đã thay đổi vào out (ghi đè), xóa cờ dirty.
+  // Trả về số máy trong snapshot, 0 nếu không có gì để gửi.
+  size_t drainSnapshot(std::string& out, const char* gatewayId, uint64_t nowMs);
+
+  size_t size() const { return slots_.size(); }
+  uint64_t ingested() const { return ingested_; }
+  uint64_t rejected() const { return rejected_; }
+
+ private:
+  MachineSlot& slotFor(const char* machineId);
+
+  std::vector<MachineSlot> slots_;
+  std::unordered_map<std::string, size_t> index_;
+  uint64_t ingested_ = 0;
+  uint64_t rejected_ = 0;
+  uint64_t ingestedSinceDrain_ = 0;
+};
+
+#endif
@@ -0,0 +1,307 @@
+// ============================================
+// LAUNDRY MQTT GATEWAY
+// Gom status của cả tiệm giặt, gửi 1 snapshot mỗi chu kỳ lên server.
+//
+//   laundry/+/status  -> bảng MachineTable (ghi đè, gộp)  -> laundry/gateway/snapshot
+//   laundry/events    -> chuyển tiếp ngay                  -> laundry/gateway/events
+//   laundry/errors    -> chuyển tiếp ngay                  -> laundry/gateway/errors
+//
+// Upstream mất kết nối: events/errors xếp hàng (tối đa GW_PENDING_MAX) và gửi
+// lại theo thứ tự khi kết nối lại; snapshot chờ tới chu kỳ có kết nối.
+//
+// Khi upstream là broker riêng (-H/-P), lệnh của server đi ngược xuống:
+//   upstream laundry/+/command, laundry/all/command  -> downstream cùng topic
+// Lệnh không xếp hàng: START/RESET tới trễ vài phút nguy hiểm hơn là mất
+// (server gửi lại được). Cùng 1 broker thì máy giặt nhận trực tiếp, không relay
+// (relay sẽ tự nhận lại chính message nó publish).
+//
+// Chạy: laundry-gateway [-h host] [-p port] [-H upstream_host] [-P upstream_port]
+//                       [-i interval_ms] [-g gateway_id] [-C ca_file]
+//   -C: kết nối TLS tới cả 2 broker, verify bằng CA này (xem tools/mosquitto-tls)
+// ============================================
+#include <mosquitto.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "laundry_protocol.h"
+#include "machine_table.h"
+#include "pending_queue.h"
+
+#define GW_PENDING_MAX  4096    // events/errors ~200 bytes -> tối đa ~1 MB RAM
+
+struct GatewayConfig {
+  std::string host = "localhost";
+  int port = 1883;
+  std::string upstreamHost;       // Rỗng = cùng broker với máy giặt
+  int upstreamPort = 0;
+  int intervalMs = 1000;
+  std::string gatewayId = "GATEWAY_01";
+  std::string caFile;             // Rỗng = TCP thường
+  bool relayCommands = false;     // Upstream là broker khác
+};
+
+struct Gateway {
+  GatewayConfig config;
+  struct mosquitto* downstream = nullptr;
+  struct mosquitto* upstream = nullptr;
+
+  std::mutex tableMutex;
+  MachineTable table;
+
+  // Events/errors chờ upstream; publish cũng giữ mutex này để không chen hàng
+  std::mutex pendingMutex;
+  PendingQueue pending{GW_PENDING_MAX};
+  std::atomic<bool> upstreamConnected{false};
+
+  std::atomic<uint64_t> forwarded{0};
+  std::atomic<uint64_t> snapshots{0};
+  std::atomic<uint64_t> snapshotsDropped{0};
+  std::atomic<uint64_t> commands{0};
+  std::atomic<uint64_t> commandsDropped{0};
+};
+
+static std::atomic<bool> running{true};
+
+static uint64_t nowMs() {
+  using namespace std::chrono;
+  return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static void onSignal(int) {
+  running = false;
+}
+
+static void onConnect(struct mosquitto* mosq, void*, int rc) {
+  if (rc != 0) {
+    fprintf(stderr, "Downstream connect failed: %s\n", mosquitto_connack_string(rc));
+    return;
+  }
+  printf("Downstream connected\n");
+  mosquitto_subscribe(mosq, nullptr, LAUNDRY_TOPIC_STATUS_ALL, 0);
+  mosquitto_subscribe(mosq, nullptr, LAUNDRY_TOPIC_EVENTS, 1);
+  mosquitto_subscribe(mosq, nullptr, LAUNDRY_TOPIC_ERRORS, 1);
+}
+
+// Gửi events/errors đang chờ theo thứ tự; dừng ở message đầu tiên publish lỗi
+static void flushPending(Gateway* gw) {
+  std::lock_guard<std::mutex> lock(gw->pendingMutex);
+  while (!gw->pending.empty() && gw->upstreamConnected) {
+    const PendingMessage& m = gw->pending.front();
+    int rc = mosquitto_publish(gw->upstream, nullptr, m.topic.c_str(), (int)m.payload.size(),
+                               m.payload.data(), 1, false);
+    if (rc != MOSQ_ERR_SUCCESS) break;
+    gw->pending.pop();
+    gw->forwarded++;
+  }
+}
+
+// QoS 1 là at-least-once: publish lỗi thì xếp hàng gửi lại, chấp nhận trùng
+// (libmosquitto có thể đã giữ bản QoS 1 đó), không chấp nhận mất.
+static void forwardEvent(Gateway* gw, const char* topic, const void* payload, int len) {
+  std::lock_guard<std::mutex> lock(gw->pendingMutex);
+  if (gw->pending.empty() && gw->upstreamConnected &&
+      mosquitto_publish(gw->upstream, nullptr, topic, len, payload, 1, false) == MOSQ_ERR_SUCCESS) {
+    gw->forwarded++;
+    return;
+  }
+  gw->pending.push(topic, payload, len);
+}
+
+static void onMessage(struct mosquitto*, void* obj, const struct mosquitto_message* msg) {
+  Gateway* gw = static_cast<Gateway*>(obj);
+  const char* payload = static_cast<const char*>(msg->payload);
+
+  // Events/errors: không gộp, chuyển tiếp ngay với QoS 1
+  if (strcmp(msg->topic, LAUNDRY_TOPIC_EVENTS) == 0) {
+    forwardEvent(gw, LAUNDRY_TOPIC_GW_EVENTS, payload, msg->payloadlen);
+    return;
+  }
+  if (strcmp(msg->topic, LAUNDRY_TOPIC_ERRORS) == 0) {
+    forwardEvent(gw, LAUNDRY_TOPIC_GW_ERRORS, payload, msg->payloadlen);
+    return;
+  }
+
+  bool isStatus = false;
+  mosquitto_topic_matches_sub(LAUNDRY_TOPIC_STATUS_ALL, msg->topic, &isStatus);
+  if (!isStatus) return;
+
+  std::lock_guard<std::mutex> lock(gw->tableMutex);
+  gw->table.applyStatus(payload, msg->payloadlen, nowMs());
+}
+
+static void onUpstreamConnect(struct mosquitto* mosq, void* obj, int rc) {
+  Gateway* gw = static_cast<Gateway*>(obj);
+  if (rc != 0) {
+    fprintf(stderr, "Upstream connect failed: %s\n", mosquitto_connack_string(rc));
+    return;
+  }
+  printf("Upstream connected\n");
+  // "+" cũng khớp laundry/all/command; subscribe thêm sẽ nhận 2 bản mỗi lệnh
+  if (gw->config.relayCommands) {
+    mosquitto_subscribe(mosq, nullptr, LAUNDRY_TOPIC_COMMAND("+"), 1);
+  }
+  gw->upstreamConnected = true;
+  flushPending(gw);
+}
+
+static void onUpstreamDisconnect(struct mosquitto*, void* obj, int) {
+  Gateway* gw = static_cast<Gateway*>(obj);
+  gw->upstreamConnected = false;
+}
+
+// Lệnh từ server: chuyển nguyên topic/payload/QoS xuống broker của máy giặt
+static void onUpstreamMessage(struct mosquitto*, void* obj, const struct mosquitto_message* msg) {
+  Gateway* gw = static_cast<Gateway*>(obj);
+  int rc = mosquitto_publish(gw->downstream, nullptr, msg->topic, msg->payloadlen, msg->payload,
+                             msg->qos, false);
+  if (rc == MOSQ_ERR_SUCCESS) {
+    gw->commands++;
+  } else {
+    gw->commandsDropped++;
+    fprintf(stderr, "Command to %s dropped: %s\n", msg->topic, mosquitto_strerror(rc));
+  }
+}
+
+static bool parseArgs(int argc, char** argv, GatewayConfig& config) {
+  int opt;
+  while ((opt = getopt(argc, argv, "h:p:H:P:i:g:C:")) != -1) {
+    switch (opt) {
+      case 'h': config.host = optarg; break;
+      case 'p': config.port = atoi(optarg); break;
+      case 'H': config.upstreamHost = optarg; break;
+      case 'P': config.upstreamPort = atoi(optarg); break;
+      case 'i': config.intervalMs = atoi(optarg); break;
+      case 'g': config.gatewayId = optarg; break;
+      case 'C': config.caFile = optarg; break;
+      default:
+        fprintf(stderr,
+                "Usage: %s [-h host] [-p port] [-H upstream_host] [-P upstream_port]"
+                " [-i interval_ms] [-g gateway_id] [-C ca_file]\n", argv[0]);
+        return false;
+    }
+  }
+  if (config.upstreamHost.empty()) config.upstreamHost = config.host;
+  if (config.upstreamPort == 0) config.upstreamPort = config.port;
+  config.relayCommands = config.upstreamHost != config.host || config.upstreamPort != config.port;
+  if (config.intervalMs <= 0) config.intervalMs = 1000;
+  return true;
+}
+
+static struct mosquitto* createClient(const std::string& id, Gateway* gw) {
+  struct mosquitto* mosq = mosquitto_new(id.c_str(), true, gw);
+  if (!mosq) return nullptr;
+  mosquitto_reconnect_delay_set(mosq, 1, 30, true);
+  if (!gw->config.caFile.empty()) {
+    int rc = mosquitto_tls_set(mosq, gw->config.caFile.c_str(), nullptr, nullptr, nullptr, nullptr);
+    if (rc != MOSQ_ERR_SUCCESS) {
+      fprintf(stderr, "TLS setup failed: %s\n", mosquitto_strerror(rc));
+      mosquitto_destroy(mosq);
+      return nullptr;
+    }
+  }
+  return mosq;
+}
+
+int main(int argc, char** argv) {
+  Gateway gw;
+  if (!parseArgs(argc, argv, gw.config)) return 1;
+  const GatewayConfig& config = gw.config;
+
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+  mosquitto_lib_init();
+
+  gw.downstream = createClient(config.gatewayId + "_sub", &gw);
+  gw.upstream = createClient(config.gatewayId + "_pub", &gw);
+  if (!gw.downstream || !gw.upstream) {
+    fprintf(stderr, "MQTT client setup failed\n");
+    return 1;
+  }
+  mosquitto_connect_callback_set(gw.downstream, onConnect);
+  mosquitto_message_callback_set(gw.downstream, onMessage);
+  mosquitto_connect_callback_set(gw.upstream, onUpstreamConnect);
+  mosquitto_disconnect_callback_set(gw.upstream, onUpstreamDisconnect);
+  mosquitto_message_callback_set(gw.upstream, onUpstreamMessage);
+
+  // connect_async: lần kết nối đầu thất bại vẫn được loop thread thử lại
+  mosquitto_connect_async(gw.upstream, config.upstreamHost.c_str(), config.upstreamPort, 30);
+  mosquitto_connect_async(gw.downstream, config.host.c_str(), config.port, 30);
+  mosquitto_loop_start(gw.upstream);
+  mosquitto_loop_start(gw.downstream);
+
+  printf("Gateway %s: %s:%d -> %s:%d, snapshot every %d ms%s\n",
+         config.gatewayId.c_str(), config.host.c_str(), config.port,
+         config.upstreamHost.c_str(), config.upstreamPort, config.intervalMs,
+         config.relayCommands ? ", relaying commands" : "");
+
+  std::string snapshot;
+  auto next = std::chrono::steady_clock::now();
+  uint64_t lastStats = nowMs();
+  uint64_t lastIngested = 0;
+
+  while (running) {
+    next += std::chrono::milliseconds(config.intervalMs);
+    std::this_thread::sleep_until(next);
+
+    // Chưa có upstream thì không drain: các máy đã đổi vẫn dirty tới chu kỳ sau
+    size_t machines = 0;
+    if (gw.upstreamConnected) {
+      flushPending(&gw);   // Publish lỗi lúc đang kết nối: thử lại mỗi chu kỳ
+      std::lock_guard<std::mutex> lock(gw.tableMutex);
+      machines = gw.table.drainSnapshot(snapshot, config.gatewayId.c_str(), nowMs());
+    }
+    if (machines > 0) {
+      int rc = mosquitto_publish(gw.upstream, nullptr, LAUNDRY_TOPIC_GW_SNAPSHOT,
+                                 (int)snapshot.size(), snapshot.data(), 0, false);
+      if (rc == MOSQ_ERR_SUCCESS) {
+        gw.snapshots++;
+      } else {
+        gw.snapshotsDropped++;   // QoS 0: status kế tiếp của máy sẽ bù
+      }
+    }
+
+    uint64_t now = nowMs();
+    if (now - lastStats >= 10000) {
+      uint64_t ingested, rejected, dropped;
+      size_t known, pending;
+      {
+        std::lock_guard<std::mutex> lock(gw.tableMutex);
+        ingested = gw.table.ingested();
+        rejected = gw.table.rejected();
+        known = gw.table.size();
+      }
+      {
+        std::lock_guard<std::mutex> lock(gw.pendingMutex);
+        pending = gw.pending.size();
+        dropped = gw.pending.dropped();
+      }
+      printf("machines=%zu status=%.0f/s rejected=%llu snapshots=%llu/%llu dropped"
+             " forwarded=%llu pending=%zu dropped=%llu commands=%llu/%llu dropped\n",
+             known, (ingested - lastIngested) * 1000.0 / (now - lastStats),
+             (unsigned long long)rejected, (unsigned long long)gw.snapshots.load(),
+             (unsigned long long)gw.snapshotsDropped.load(),
+             (unsigned long long)gw.forwarded.load(), pending, (unsigned long long)dropped,
+             (unsigned long long)gw.commands.load(), (unsigned long long)gw.commandsDropped.load());
+      lastStats = now;
+      lastIngested = ingested;
+    }
+  }
+
+  mosquitto_disconnect(gw.downstream);
+  mosquitto_disconnect(gw.upstream);
+  mosquitto_loop_stop(gw.downstream, false);
+  mosquitto_loop_stop(gw.upstream, false);
+  mosquitto_destroy(gw.downstream);
+  mosquitto_destroy(gw.upstream);
+  mosquitto_lib_cleanup();
+  return 0;
+}
@@ -0,0 +1,13 @@
+#include "pending_queue.h"
+
+void PendingQueue::push(const char* topic, const void* payload, size_t len) {
+  if (capacity_ == 0) {
+    dropped_++;
+    return;
+  }
+  if (items_.size() >= capacity_) {
+    items_.pop_front();
+    dropped_++;
+  }
+  items_.push_back(PendingMessage{topic, std::string(static_cast<const char*>(payload), len)});
+}
@@ -0,0 +1,40 @@
+// ============================================
+// PENDING QUEUE
+// Events/errors chưa gửi được lên upstream (mất kết nối, publish lỗi), giữ
+// theo thứ tự tới khi upstream kết nối lại. Có giới hạn: đầy thì bỏ message
+// cũ nhất và đếm vào dropped().
+// Không thread-safe: gateway bọc bằng mutex.
+// ============================================
+#ifndef GATEWAY_PENDING_QUEUE_H
+#define GATEWAY_PENDING_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <string>
+
+struct PendingMessage {
+  std::string topic;
+  std::string payload;
+};
+
+class PendingQueue {
+ public:
+  explicit PendingQueue(size_t capacity) : capacity_(capacity) {}
+
+  void push(const char* topic, const void* payload, size_t len);
+  void pop() { items_.pop_front(); }
+  const PendingMessage& front() const { return items_.front(); }
+
+  bool empty() const { return items_.empty(); }
+  size_t size() const { return items_.size(); }
+  uint64_t dropped() const { return dropped_; }
+
+ private:
+  std::deque<PendingMessage> items_;
+  size_t capacity_;
+  uint64_t dropped_ = 0;
+};
+
+#endif
@@ -0,0 +1,166 @@
+// ============================================
+// GATEWAY TESTS (không cần broker)
+//   gateway-test        hoặc   ctest --test-dir build
+// FlatJsonReader phải từ chối JSON hỏng; MachineTable chỉ ghi đè trường có mặt;
+// PendingQueue giữ thứ tự và chỉ bỏ message cũ nhất khi đầy.
+// ============================================
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+
+#include "json_fields.h"
+#include "machine_table.h"
+#include "pending_queue.h"
+
+static int failures = 0;
+
+#define CHECK(cond)                                              \
+  do {                                                           \
+    if (!(cond)) {                                               \
+      fprintf(stderr, "%s:%d: CHECK(%s)\n", __FILE__, __LINE__, #cond); \
+      failures++;                                                \
+    }                                                            \
+  } while (0)
+
+// Đọc hết object, trả về số trường; -1 nếu reader failed()
+static int countFields(const char* json) {
+  FlatJsonReader reader(json, strlen(json));
+  JsonField f;
+  int n = 0;
+  while (reader.next(f)) n++;
+  return reader.failed() ? -1 : n;
+}
+
+static void testReaderAccepts() {
+  CHECK(countFields("{}") == 0);
+  CHECK(countFields(" { } ") == 0);
+  CHECK(countFields("{\"a\":1}") == 1);
+  CHECK(countFields("{\"a\": -1.5e3 , \"b\":\"x\" ,\"c\":true,\"d\":false,\"e\":null}") == 5);
+  CHECK(countFields("{\"boot\":{\"lcdMs\":1,\"x\":[1,{\"y\":\"}\"}]},\"n\":2}") == 2);
+  CHECK(countFields("{\"s\":\"a\\\"b\"}") == 1);
+}
+
+static void testReaderRejects() {
+  CHECK(countFields("") == -1);
+  CHECK(countFields("[]") == -1);
+  CHECK(countFields("{") == -1);
+  CHECK(countFields("{\"progress\": }") == -1);
+  CHECK(countFields("{\"progress\":,\"a\":1}") == -1);
+  CHECK(countFields("{\"a\":1,}") == -1);
+  CHECK(countFields("{,\"a\":1}") == -1);
+  CHECK(countFields("{\"a\":1,,\"b\":2}") == -1);
+  CHECK(countFields("{\"a\":1 \"b\":2}") == -1);
+  CHECK(countFields("{\"a\":01}") == -1);
+  CHECK(countFields("{\"a\":1.}") == -1);
+  CHECK(countFields("{\"a\":tru}") == -1);
+  CHECK(countFields("{\"a\":abc}") == -1);
+  CHECK(countFields("{\"a\":\"open}") == -1);
+  CHECK(countFields("{\"a\":{\"b\":1}") == -1);
+  CHECK(countFields("{a:1}") == -1);
+}
+
+static bool apply(MachineTable& table, const char* json) {
+  return table.applyStatus(json, strlen(json), 0);
+}
+
+static std::string drain(MachineTable& table) {
+  std::string out;
+  table.drainSnapshot(out, "GW", 0);
+  return out;
+}
+
+static bool contains(const std::string& s, const char* part) {
+  return s.find(part) != std::string::npos;
+}
+
+static void testTableKeepsMissingFields() {
+  MachineTable table;
+  CHECK(apply(table, "{\"machineId\":\"M1\",\"state\":\"WASHING\",\"progress\":40,"
+                     "\"waterLevel\":90,\"mode\":\"HEAVY\",\"orderCode\":\"ORD1\","
+                     "\"doorOpen\":false,\"timestamp\":1000}"));
+  drain(table);
+
+  // Thiếu orderCode/progress/mode: giữ giá trị cũ
+  CHECK(apply(table, "{\"machineId\":\"M1\",\"state\":\"DRAINING\",\"timestamp\":2000}"));
+  std::string out = drain(table);
+  CHECK(contains(out, "\"state\":\"DRAINING\""));
+  CHECK(contains(out, "\"orderCode\":\"ORD1\""));
+  CHECK(contains(out, "\"progress\":40"));
+  CHECK(contains(out, "\"mode\":\"HEAVY\""));
+  CHECK(contains(out, "\"timestamp\":2000"));
+
+  // Sai kiểu: bỏ qua trường đó, phần còn lại vẫn áp dụng
+  CHECK(apply(table, "{\"machineId\":\"M1\",\"state\":\"DRAINING\",\"progress\":\"x\","
+                     "\"orderCode\":5,\"waterLevel\":50}"));
+  out = drain(table);
+  CHECK(contains(out, "\"progress\":40"));
+  CHECK(contains(out, "\"orderCode\":\"ORD1\""));
+  CHECK(contains(out, "\"waterLevel\":50"));
+}
+
+static void testTableRejectsMalformed() {
+  MachineTable table;
+  CHECK(apply(table, "{\"machineId\":\"M1\",\"state\":\"WASHING\",\"progress\":40,"
+                     "\"orderCode\":\"ORD1\"}"));
+  drain(table);
+
+  CHECK(!apply(table, "{\"machineId\":\"M1\",\"state\":\"WASHING\",\"progress\": }"));
+  CHECK(!apply(table, "{\"machineId\":\"M1\",\"state\":\"WASHING\",\"orderCode\":\"\",}"));
+  CHECK(!apply(table, "{\"machineId\":\"M1\",\"state\":\"BOGUS\"}"));
+  CHECK(!apply(table, "{\"state\":\"WASHING\"}"));
+  CHECK(table.rejected() == 4);
+  CHECK(drain(table).empty());   // Không slot nào bị đánh dấu thay đổi
+}
+
+static void testTableErrorCode() {
+  MachineTable table;
+  CHECK(apply(table, "{\"machineId\":\"M1\",\"state\":\"ERROR_DOOR\",\"errorCode\":\"DOOR_OPEN\"}"));
+  CHECK(contains(drain(table), "\"errorCode\":\"DOOR_OPEN\""));
+
+  // Vẫn lỗi nhưng message không kèm errorCode: giữ mã cũ
+  CHECK(apply(table, "{\"machineId\":\"M1\",\"state\":\"ERROR_DOOR\"}"));
+  CHECK(contains(drain(table), "\"errorCode\":\"DOOR_OPEN\""));
+
+  // Firmware bỏ errorCode khi hết lỗi
+  CHECK(apply(table, "{\"machineId\":\"M1\",\"state\":\"PAUSED\"}"));
+  CHECK(contains(drain(table), "\"errorCode\":null"));
+}
+
+static void testPendingQueue() {
+  PendingQueue queue(3);
+  const char* events[] = { "e1", "e2", "e3", "e4", "e5" };
+  for (const char* e : events) queue.push("laundry/gateway/events", e, strlen(e));
+
+  // Đầy: e1, e2 bị bỏ, còn lại theo đúng thứ tự
+  CHECK(queue.size() == 3);
+  CHECK(queue.dropped() == 2);
+  CHECK(queue.front().topic == "laundry/gateway/events");
+  CHECK(queue.front().payload == "e3");
+  queue.pop();
+  CHECK(queue.front().payload == "e4");
+  queue.pop();
+  queue.pop();
+  CHECK(queue.empty());
+  CHECK(queue.dropped() == 2);
+
+  // Payload nhị phân giữ nguyên độ dài
+  queue.push("t", "a\0b", 3);
+  CHECK(queue.front().payload.size() == 3);
+}
+
+int main() {
+  testReaderAccepts();
+  testReaderRejects();
+  testTableKeepsMissingFields();
+  testTableRejectsMalformed();
+  testTableErrorCode();
+  testPendingQueue();
+
+  if (failures) {
+    fprintf(stderr, "%d check(s) failed\n", failures);
+    return 1;
+  }
+  printf("gateway-test: all checks passed\n");
+  return 0;
+}
@@ -0,0 +1,81 @@
+// ============================================
+// BROKER TRANSPORT
+// Client (Arduino) cho PubSubClient: TCP thường, hoặc TLS 1.2 qua mbedtls khi
+// build với -DBROKER_TLS (mặc định tắt).
+// Khi bật TLS chỉ dùng ECDHE-ECDSA + P-256 (chứng chỉ nhỏ hơn RSA ~3 lần, ít
+// byte phải nhận/hash hơn) và giữ TLS session (ticket hoặc session ID) dùng
+// chung cho mọi instance: lần reconnect sau bỏ qua chứng chỉ + ECDHE, chỉ còn
+// 1 RTT với vài phép hash/AES.
+// connect() block tới hết handshake: chỉ gọi từ mqttConnectTask.
+// Viết cho mbedtls 2.x (ESP-IDF 4.4 / Arduino-ESP32 2.x).
+// BROKER_TLS tắt mặc định vì nhánh TLS CHƯA CHẠY TRÊN ESP32: mới chỉ được
+// build trên stub mbedtls (test/host, target broker-tls-syntax), chưa build với
+// mbedtls thật và chưa handshake với broker nào. Không có cờ thì setupTls() từ
+// chối mọi CA và firmware không có mã mbedtls nào. Trước khi bật cho máy thật,
+// chạy tools/mosquitto-tls và xem log "Connected! ... (full)" / "(resumed)"
+// và "mqttConnect stack".
+// ============================================
+#ifndef BROKER_TRANSPORT_H
+#define BROKER_TRANSPORT_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#ifdef BROKER_TLS
+#include <mbedtls/ssl.h>
+#endif
+
+#define BROKER_HOST_MAX_LEN           63
+#define BROKER_TLS_HANDSHAKE_TIMEOUT_MS  10000
+
+// Số đo của lần connect() gần nhất
+struct BrokerHandshakeStats {
+  bool tls;
+  bool resumed;               // Server chấp nhận session đã lưu
+  uint32_t tcpMs;             // DNS + TCP connect
+  uint32_t handshakeMs;       // TLS handshake (0 nếu TCP thường)
+};
+
+class BrokerTransport : public Client {
+public:
+  BrokerTransport();
+  ~BrokerTransport();
+
+  // Gọi 1 lần trước connect(), trước khi mqttConnectTask chạy.
+  // caPem NULL/rỗng -> chỉ TCP thường. Trả false nếu không parse được CA,
+  // hoặc có CA mà firmware không build với BROKER_TLS.
+  static bool setupTls(const char* caPem);
+  static bool tlsEnabled();
+
+  int connect(IPAddress ip, uint16_t port) override;
+  int connect(const char* host, uint16_t port) override;
+  size_t write(uint8_t b) override;
+  size_t write(const uint8_t* buf, size_t size) override;
+  int available() override;
+  int read() override;
+  int read(uint8_t* buf, size_t size) override;
+  int peek() override;
+  void flush() override;
+  void stop() override;
+  uint8_t connected() override;
+  operator bool() override { return connected(); }
+
+  const BrokerHandshakeStats& lastHandshake() const { return stats; }
+
+private:
+  int finishConnect(const char* host, uint32_t start);
+
+  WiFiClient tcp;
+  int peeked;                 // -1 = không có byte peek
+  BrokerHandshakeStats stats;
+
+#ifdef BROKER_TLS
+  bool handshake(const char* host);
+  static int onVerify(void* ctx, mbedtls_x509_crt* crt, int depth, uint32_t* flags);
+
+  mbedtls_ssl_context ssl;
+  bool sslActive;
+  bool certVerified;          // Handshake này có nhận chứng chỉ server không
+#endif
+};
+
+#endif
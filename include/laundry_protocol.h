@@ -0,0 +1,83 @@
+// ============================================
+// LAUNDRY PROTOCOL - Định nghĩa message MQTT dùng chung
+// Firmware (src/main.cpp) và gateway (gateway/) cùng include file này
+// ============================================
+#ifndef LAUNDRY_PROTOCOL_H
+#define LAUNDRY_PROTOCOL_H
+
+#include <stdint.h>
+#include <string.h>
+
+// ============================================
+// TOPICS
+// ============================================
+// Máy giặt -> server
+#define LAUNDRY_TOPIC_STATUS(id)      "laundry/" id "/status"
+#define LAUNDRY_TOPIC_TELEMETRY(id)   "laundry/" id "/telemetry"
+#define LAUNDRY_TOPIC_ERRORS          "laundry/errors"
+#define LAUNDRY_TOPIC_EVENTS          "laundry/events"
+#define LAUNDRY_TOPIC_STATUS_ALL      "laundry/+/status"
+
+// Server -> máy giặt
+#define LAUNDRY_TOPIC_COMMAND(id)     "laundry/" id "/command"
+#define LAUNDRY_TOPIC_COMMAND_ALL     "laundry/all/command"    // Chỉ GET_STATUS
+
+// Gateway -> server (xem gateway/)
+#define LAUNDRY_TOPIC_GW_SNAPSHOT     "laundry/gateway/snapshot"
+#define LAUNDRY_TOPIC_GW_EVENTS       "laundry/gateway/events"
+#define LAUNDRY_TOPIC_GW_ERRORS       "laundry/gateway/errors"
+
+// ============================================
+// GIỚI HẠN TRƯỜNG
+// ============================================
+#define LAUNDRY_MACHINE_ID_MAX_LEN    15
+#define LAUNDRY_ORDER_CODE_MAX_LEN    15
+#define LAUNDRY_MODE_MAX_LEN          7     // "NORMAL" / "HEAVY"
+#define LAUNDRY_ERROR_CODE_MAX_LEN    15    // "DOOR_OPEN" / "WATER_TIMEOUT"
+
+// ============================================
+// CÁC TRẠNG THÁI MÁY GIẶT
+// ============================================
+enum State : uint8_t {
+  POWER_OFF, READY, CHECK_SYSTEM, FILLING, MIXING,
+  SENSING, WASHING, DRAINING, SPINNING, PAUSED,
+  ERROR_DOOR, ERROR_WATER, DONE
+};
+
+static const uint8_t STATE_COUNT = DONE + 1;
+
+static const char* const stateNames[STATE_COUNT] = {
+  "POWER_OFF", "READY", "CHECK_SYSTEM", "FILLING", "MIXING",
+  "SENSING", "WASHING", "DRAINING", "SPINNING", "PAUSED",
+  "ERROR_DOOR", "ERROR_WATER", "DONE"
+};
+
+// Trả về -1 nếu tên không hợp lệ
+inline int stateFromName(const char* name) {
+  for (uint8_t i = 0; i < STATE_COUNT; i++) {
+    if (strcmp(stateNames[i], name) == 0) return i;
+  }
+  return -1;
+}
+
+// ============================================
+// STATUS MESSAGE (LAUNDRY_TOPIC_STATUS, JSON)
+// ============================================
+// { machineId, state, progress, waterLevel, mode, orderCode,
+//   doorOpen, timestamp, errorCode? }
+#define LAUNDRY_STATUS_FIELDS         9
+
+// ============================================
+// TELEMETRY FRAME (LAUNDRY_TOPIC_TELEMETRY, nhị phân)
+// ============================================
+// Xem phần TELEMETRY FRAMES trong src/main.cpp
+#define TELEMETRY_VERSION             1
+#define TELEMETRY_HEADER_BYTES        10
+
+// Byte flags của mỗi mẫu
+#define TELEMETRY_FLAG_MOTOR          0x01
+#define TELEMETRY_FLAG_VALVE          0x02
+#define TELEMETRY_FLAG_DOOR           0x04
+#define TELEMETRY_STATE_SHIFT         3     // bit3-7: State
+
+#endif
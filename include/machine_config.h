@@ -0,0 +1,66 @@
+// ============================================
+// MACHINE CONFIG - Chân GPIO, ngưỡng và thời lượng của máy giặt
+// src/main.cpp và test/host (kịch bản lỗi) cùng include file này
+// ============================================
+#ifndef MACHINE_CONFIG_H
+#define MACHINE_CONFIG_H
+
+// Machine ID - ĐỔI CHO MỖI MÁY: MACHINE_01, MACHINE_02, MACHINE_03, MACHINE_04
+#define MACHINE_ID        "MACHINE_01"
+
+// ============================================
+// CẤU HÌNH CHÂN GPIO
+// ============================================
+#define PIN_RELAY_MOTOR   26
+#define PIN_RELAY_VALVE   32
+#define PIN_POT_WATER     34
+#define PIN_POT_DIRT      35
+#define PIN_DOOR_SWITCH   13
+#define PIN_BUZZER        15
+#define PIN_BTN_START     12
+#define PIN_BTN_PAUSE     14
+
+// ============================================
+// HẰNG SỐ CẤU HÌNH
+// ============================================
+#define WATER_FULL_THRESHOLD      90
+#define WATER_EMPTY_THRESHOLD     5
+#define WATER_CONFIRM_READS       3      // Số vòng loop liên tiếp xác nhận đầy/cạn
+#define DIRT_HEAVY_THRESHOLD      3000
+
+#define FILL_TIMEOUT_MS           10000
+#define MIX_DURATION_MS           5000
+#define HEAVY_WASH_DURATION_MS    15000
+#define NORMAL_WASH_DURATION_MS   8000
+#define SPIN_DURATION_MS          5000
+#define DONE_AUTO_OFF_MS          10000
+#define SENSING_DELAY_MS          2000
+
+#define DEBOUNCE_DELAY_MS         50
+#define DOOR_CLOSE_DEBOUNCE_MS    200    // Cửa phải đóng ổn định mới thoát ERROR_DOOR
+#define BEEP_INTERVAL_MS          500
+#define LOOP_DELAY_MS             20
+#define MQTT_INTERVAL_MS          2000   // Nhịp nền; giữ 2s tới khi admin UI dùng SUBSCRIBE_FAST
+#define MQTT_FAST_INTERVAL_MS     500    // SUBSCRIBE_FAST mặc định
+#define MQTT_FAST_MIN_INTERVAL_MS 250
+#define MQTT_FAST_DEFAULT_MS      30000  // Thời hạn lease SUBSCRIBE_FAST
+#define MQTT_FAST_MAX_MS          120000
+#define MQTT_RETRY_MS             5000
+#define MQTT_SOCKET_TIMEOUT_S     2
+#define MQTT_COMMAND_MAX_LEN      200    // Lệnh dài hơn bị bỏ qua trước khi parse
+
+#define SPLASH_DURATION_MS        1000
+#define SPLASH_BEEP_DELAY_MS      150
+#define POWER_OFF_MSG_MS          1000
+
+// Telemetry độ phân giải cao: lấy mẫu 10 Hz, gửi 1 frame mỗi 5s
+#define TELEMETRY_SAMPLE_MS       100
+#define TELEMETRY_FRAME_MS        5000
+#define TELEMETRY_MAX_SAMPLES     64
+
+// Bộ đếm bền vững (NVS): gom trong RAM, ghi flash theo lô
+#define COUNTER_FLUSH_MS          600000UL   // Ghi khi rảnh, tối đa 10 phút/lần
+#define COUNTER_FORCE_FLUSH_MS    3600000UL  // Ghi bắt buộc dù máy đang chạy
+#define HEARTBEAT_INTERVAL_MS     60000
+
+#endif
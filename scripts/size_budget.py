@@ -0,0 +1,129 @@
+# ============================================
+# FIRMWARE SIZE BUDGET
+# Chạy: pio run -t size_budget
+# In dung lượng .data/.bss/.rodata/text theo section và theo symbol,
+# trả về lỗi nếu vượt ngân sách khai báo trong platformio.ini
+# (custom_budget_data, custom_budget_bss, custom_budget_rodata, custom_budget_text),
+# hoặc nếu ngân sách chưa được khai báo.
+#
+# Ngân sách phải lấy từ số đo thật: pio run -t size_baseline in ra các dòng
+# custom_budget_* = dung lượng đo được + custom_budget_headroom (%), làm tròn 256.
+# ============================================
+import re
+import subprocess
+
+Import("env")
+
+CLASSES = ("data", "bss", "rodata", "text")
+
+
+def classify(section):
+    # Thứ tự quan trọng: ".flash.rodata" cũng chứa "data"
+    if ".text" in section or section.endswith(".vectors"):
+        return "text"
+    if "rodata" in section or section.endswith(".appdesc"):
+        return "rodata"
+    if "bss" in section or section.endswith(".noinit"):
+        return "bss"
+    if ".data" in section:
+        return "data"
+    return None
+
+
+def readelf(tool, *args):
+    return subprocess.check_output([tool] + list(args), universal_newlines=True)
+
+
+def read_sections(tool, elf):
+    # [Nr] Name Type Addr Off Size ES Flg Lk Inf Al
+    sections = {}
+    for line in readelf(tool, "-SW", elf).splitlines():
+        m = re.match(r"\s*\[\s*(\d+)\]\s+(\S+)\s+\S+\s+[0-9a-f]+\s+[0-9a-f]+\s+([0-9a-f]+)", line)
+        if m:
+            sections[int(m.group(1))] = (m.group(2), int(m.group(3), 16))
+    return sections
+
+
+def read_symbols(tool, elf, sections):
+    # Num: Value Size Type Bind Vis Ndx Name
+    symbols = {cls: [] for cls in CLASSES}
+    for line in readelf(tool, "-sW", "-C", elf).splitlines():
+        parts = line.split(None, 7)
+        if len(parts) < 8 or not parts[6].isdigit():
+            continue
+        size = int(parts[2], 0)
+        section = sections.get(int(parts[6]))
+        if size == 0 or section is None:
+            continue
+        cls = classify(section[0])
+        if cls:
+            symbols[cls].append((size, parts[7]))
+    return symbols
+
+
+def measure(env, elf):
+    tool = env.subst("$OBJCOPY").replace("objcopy", "readelf")
+    sections = read_sections(tool, elf)
+    symbols = read_symbols(tool, elf, sections)
+
+    totals = dict.fromkeys(CLASSES, 0)
+    for name, size in sections.values():
+        cls = classify(name)
+        if cls:
+            totals[cls] += size
+    return totals, symbols
+
+
+def print_baseline(target, source, env):
+    totals, _ = measure(env, str(source[0]))
+    headroom = int(env.GetProjectOption("custom_budget_headroom", "5"))
+
+    print("\nMeasured sizes; budgets with %d%% headroom for platformio.ini:" % headroom)
+    for cls in CLASSES:
+        budget = (totals[cls] * (100 + headroom) // 100 + 255) // 256 * 256
+        print("custom_budget_%-7s = %-8d ; measured %d" % (cls, budget, totals[cls]))
+    return 0
+
+
+def check_budget(target, source, env):
+    top = int(env.GetProjectOption("custom_budget_top", "15"))
+    totals, symbols = measure(env, str(source[0]))
+
+    for cls in CLASSES:
+        print("\n%s: %d bytes, top %d symbols" % (cls, totals[cls], top))
+        for size, name in sorted(symbols[cls], reverse=True)[:top]:
+            print("  %8d  %s" % (size, name))
+
+    failed = False
+    missing = False
+    print("\n%-8s %10s %10s" % ("", "used", "budget"))
+    for cls in CLASSES:
+        budget = int(env.GetProjectOption("custom_budget_" + cls, "0"))
+        over = budget and totals[cls] > budget
+        status = "  OVER BUDGET" if over else ("  NO BUDGET" if not budget else "")
+        print("%-8s %10d %10s%s" % (cls, totals[cls], budget or "-", status))
+        failed = failed or over
+        missing = missing or not budget
+
+    # Gate chưa có số đo thì không được coi là pass
+    if missing:
+        print("\nBudgets not recorded: run `pio run -t size_baseline` and copy the "
+              "custom_budget_* lines into platformio.ini")
+    return 1 if failed or missing else 0
+
+
+env.AddCustomTarget(
+    name="size_budget",
+    dependencies="$BUILD_DIR/${PROGNAME}.elf",
+    actions=[check_budget],
+    title="Size Budget",
+    description="Report .data/.bss/.rodata/text per symbol and enforce size budgets",
+)
+
+env.AddCustomTarget(
+    name="size_baseline",
+    dependencies="$BUILD_DIR/${PROGNAME}.elf",
+    actions=[print_baseline],
+    title="Size Baseline",
+    description="Print measured sizes as custom_budget_* lines for platformio.ini",
+)
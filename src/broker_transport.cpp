@@ -0,0 +1,333 @@
+// ============================================
+// BROKER TRANSPORT - xem include/broker_transport.h
+// ============================================
+#include "broker_transport.h"
+
+static bool tlsReady = false;
+
+#ifdef BROKER_TLS
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/net_sockets.h>
+#include <mbedtls/x509_crt.h>
+
+// Chỉ 1 suite / 1 curve: ClientHello nhỏ, không phải thương lượng sang RSA
+static const int TLS_CIPHERSUITES[] = {
+  MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256,
+  0
+};
+
+static const mbedtls_ecp_group_id TLS_CURVES[] = {
+  MBEDTLS_ECP_DP_SECP256R1,
+  MBEDTLS_ECP_DP_NONE
+};
+
+// Dùng chung cho mọi instance: CA/config parse 1 lần, session giữ qua các lần
+// reconnect dù mqttConnectTask luân phiên 2 socket.
+// Không có mutex vì mỗi biến chỉ 1 task ghi:
+//   - setupTls() ghi tất cả trong setup(), trước khi mqttConnectTask được tạo.
+//   - Sau đó chỉ handshake(), tức mqttConnectTask, đọc/ghi tlsSession,
+//     tlsSessionValid và dùng RNG (tlsDrbg/tlsEntropy).
+//   - loop() chỉ gọi write/read/available/stop trên ssl của socket nó đang giữ.
+//     tlsConf lúc đó chỉ được đọc. Record AES-GCM của TLS 1.2 lấy nonce từ số
+//     thứ tự record, không gọi RNG.
+// assertTlsOwner() dừng máy nếu handshake/session bị gọi từ task khác.
+static mbedtls_entropy_context tlsEntropy;
+static mbedtls_ctr_drbg_context tlsDrbg;
+static mbedtls_x509_crt tlsCa;
+static mbedtls_ssl_config tlsConf;
+static mbedtls_ssl_session tlsSession;
+static bool tlsSessionValid = false;
+static TaskHandle_t tlsOwner = NULL;
+
+static void assertTlsOwner() {
+  if (tlsOwner == NULL) tlsOwner = xTaskGetCurrentTaskHandle();
+  configASSERT(tlsOwner == xTaskGetCurrentTaskHandle());
+}
+
+static void clearTlsSession() {
+  assertTlsOwner();
+  if (!tlsSessionValid) return;
+  mbedtls_ssl_session_free(&tlsSession);
+  tlsSessionValid = false;
+}
+
+// BIO trên WiFiClient: không block, mbedtls tự gọi lại khi WANT_READ
+static int bioSend(void* ctx, const unsigned char* buf, size_t len) {
+  WiFiClient* tcp = (WiFiClient*)ctx;
+  size_t n = tcp->write(buf, len);
+  return n > 0 ? (int)n : MBEDTLS_ERR_NET_CONN_RESET;
+}
+
+static int bioRecv(void* ctx, unsigned char* buf, size_t len) {
+  WiFiClient* tcp = (WiFiClient*)ctx;
+  if (!tcp->available()) {
+    return tcp->connected() ? MBEDTLS_ERR_SSL_WANT_READ : MBEDTLS_ERR_NET_CONN_RESET;
+  }
+  int n = tcp->read(buf, len);
+  return n > 0 ? n : MBEDTLS_ERR_SSL_WANT_READ;
+}
+
+bool BrokerTransport::setupTls(const char* caPem) {
+  if (tlsReady) return true;
+  if (caPem == NULL || caPem[0] == '\0') return true;
+
+  mbedtls_entropy_init(&tlsEntropy);
+  mbedtls_ctr_drbg_init(&tlsDrbg);
+  mbedtls_x509_crt_init(&tlsCa);
+  mbedtls_ssl_config_init(&tlsConf);
+  mbedtls_ssl_session_init(&tlsSession);
+
+  static const char pers[] = "laundry-mqtt";
+  int ret = mbedtls_ctr_drbg_seed(&tlsDrbg, mbedtls_entropy_func, &tlsEntropy,
+                                  (const unsigned char*)pers, sizeof(pers) - 1);
+  if (ret == 0) {
+    ret = mbedtls_x509_crt_parse(&tlsCa, (const unsigned char*)caPem, strlen(caPem) + 1);
+  }
+  if (ret == 0) {
+    ret = mbedtls_ssl_config_defaults(&tlsConf, MBEDTLS_SSL_IS_CLIENT,
+                                      MBEDTLS_SSL_TRANSPORT_STREAM, MBEDTLS_SSL_PRESET_DEFAULT);
+  }
+  if (ret != 0) {
+    Serial.printf("TLS setup failed: -0x%04x\n", -ret);
+    return false;
+  }
+
+  mbedtls_ssl_conf_authmode(&tlsConf, MBEDTLS_SSL_VERIFY_REQUIRED);
+  mbedtls_ssl_conf_ca_chain(&tlsConf, &tlsCa, NULL);
+  mbedtls_ssl_conf_rng(&tlsConf, mbedtls_ctr_drbg_random, &tlsDrbg);
+  mbedtls_ssl_conf_min_version(&tlsConf, MBEDTLS_SSL_MAJOR_VERSION_3, MBEDTLS_SSL_MINOR_VERSION_3);
+  mbedtls_ssl_conf_max_version(&tlsConf, MBEDTLS_SSL_MAJOR_VERSION_3, MBEDTLS_SSL_MINOR_VERSION_3);
+  mbedtls_ssl_conf_ciphersuites(&tlsConf, TLS_CIPHERSUITES);
+  mbedtls_ssl_conf_curves(&tlsConf, TLS_CURVES);
+  mbedtls_ssl_conf_session_tickets(&tlsConf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+
+  tlsReady = true;
+  return true;
+}
+#else
+bool BrokerTransport::setupTls(const char* caPem) {
+  if (caPem == NULL || caPem[0] == '\0') return true;
+  Serial.println("TLS not built in (build with -DBROKER_TLS)");
+  return false;
+}
+#endif
+
+bool BrokerTransport::tlsEnabled() {
+  return tlsReady;
+}
+
+#ifdef BROKER_TLS
+BrokerTransport::BrokerTransport() : peeked(-1), stats(), sslActive(false), certVerified(false) {
+}
+#else
+BrokerTransport::BrokerTransport() : peeked(-1), stats() {
+}
+#endif
+
+BrokerTransport::~BrokerTransport() {
+  stop();
+}
+
+#ifdef BROKER_TLS
+// Chỉ được gọi khi server gửi Certificate, tức là handshake đầy đủ
+int BrokerTransport::onVerify(void* ctx, mbedtls_x509_crt*, int, uint32_t*) {
+  ((BrokerTransport*)ctx)->certVerified = true;
+  return 0;   // Không đổi flags: VERIFY_REQUIRED vẫn quyết định kết quả
+}
+
+bool BrokerTransport::handshake(const char* host) {
+  assertTlsOwner();
+  mbedtls_ssl_init(&ssl);
+  sslActive = true;
+  certVerified = false;
+
+  int ret = mbedtls_ssl_setup(&ssl, &tlsConf);
+  if (ret == 0 && host != NULL) ret = mbedtls_ssl_set_hostname(&ssl, host);
+  if (ret == 0 && tlsSessionValid) ret = mbedtls_ssl_set_session(&ssl, &tlsSession);
+  if (ret != 0) {
+    Serial.printf("TLS init failed: -0x%04x\n", -ret);
+    return false;
+  }
+  mbedtls_ssl_set_verify(&ssl, onVerify, this);
+  mbedtls_ssl_set_bio(&ssl, &tcp, bioSend, bioRecv, NULL);
+
+  uint32_t start = millis();
+  while ((ret = mbedtls_ssl_handshake(&ssl)) != 0) {
+    if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+      Serial.printf("TLS handshake failed: -0x%04x verify=0x%x\n",
+                    -ret, (unsigned)mbedtls_ssl_get_verify_result(&ssl));
+      clearTlsSession();
+      return false;
+    }
+    if (millis() - start >= BROKER_TLS_HANDSHAKE_TIMEOUT_MS) {
+      Serial.println("TLS handshake timeout");
+      return false;
+    }
+    delay(1);
+  }
+
+  stats.resumed = tlsSessionValid && !certVerified;
+
+  // Lưu session (kèm ticket mới nếu server cấp) cho lần reconnect sau
+  clearTlsSession();
+  if (mbedtls_ssl_get_session(&ssl, &tlsSession) == 0) {
+    tlsSessionValid = true;
+  } else {
+    mbedtls_ssl_session_free(&tlsSession);
+  }
+  return true;
+}
+#endif
+
+int BrokerTransport::connect(IPAddress ip, uint16_t port) {
+  stop();
+  uint32_t start = millis();
+  if (!tcp.connect(ip, port)) return 0;
+  return finishConnect(NULL, start);
+}
+
+int BrokerTransport::connect(const char* host, uint16_t port) {
+  stop();
+  uint32_t start = millis();
+  if (!tcp.connect(host, port)) return 0;
+  return finishConnect(host, start);
+}
+
+int BrokerTransport::finishConnect(const char* host, uint32_t start) {
+  stats = BrokerHandshakeStats();
+  stats.tls = tlsReady;
+  stats.tcpMs = millis() - start;
+  tcp.setNoDelay(true);   // Tránh Nagle giữ các flight handshake / gói MQTT nhỏ
+  if (!tlsReady) return 1;
+
+#ifdef BROKER_TLS
+  start = millis();
+  if (!handshake(host)) {
+    stop();
+    return 0;
+  }
+  stats.handshakeMs = millis() - start;
+#endif
+  return 1;
+}
+
+size_t BrokerTransport::write(uint8_t b) {
+  return write(&b, 1);
+}
+
+int BrokerTransport::read() {
+  uint8_t b;
+  return read(&b, 1) == 1 ? b : -1;
+}
+
+int BrokerTransport::peek() {
+  if (peeked < 0) {
+    uint8_t b;
+    if (read(&b, 1) == 1) peeked = b;
+  }
+  return peeked;
+}
+
+#ifdef BROKER_TLS
+
+size_t BrokerTransport::write(const uint8_t* buf, size_t size) {
+  if (!sslActive) return tcp.write(buf, size);
+
+  size_t sent = 0;
+  while (sent < size) {
+    int ret = mbedtls_ssl_write(&ssl, buf + sent, size - sent);
+    if (ret <= 0) break;   // bioSend không trả WANT_WRITE -> lỗi thật
+    sent += ret;
+  }
+  return sent;
+}
+
+int BrokerTransport::available() {
+  if (!sslActive) return tcp.available();
+
+  // Đọc 0 byte để mbedtls kéo + giải mã record mới nếu socket có dữ liệu
+  int ret = mbedtls_ssl_read(&ssl, NULL, 0);
+  if (ret < 0 && ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+    stop();
+    return 0;
+  }
+  return mbedtls_ssl_get_bytes_avail(&ssl) + (peeked >= 0 ? 1 : 0);
+}
+
+int BrokerTransport::read(uint8_t* buf, size_t size) {
+  if (size == 0) return 0;
+
+  size_t offset = 0;
+  if (peeked >= 0) {
+    buf[0] = (uint8_t)peeked;
+    peeked = -1;
+    offset = 1;
+    if (size == 1) return 1;
+  }
+  if (!sslActive) {
+    int n = tcp.read(buf + offset, size - offset);
+    return n > 0 ? n + (int)offset : (offset > 0 ? (int)offset : n);
+  }
+
+  int ret = mbedtls_ssl_read(&ssl, buf + offset, size - offset);
+  if (ret > 0) return ret + (int)offset;
+  if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+    stop();   // close_notify hoặc lỗi
+  }
+  return offset > 0 ? (int)offset : -1;
+}
+
+void BrokerTransport::flush() {
+  if (!sslActive) tcp.flush();
+}
+
+void BrokerTransport::stop() {
+  if (sslActive) {
+    if (tcp.connected()) mbedtls_ssl_close_notify(&ssl);
+    mbedtls_ssl_free(&ssl);
+    sslActive = false;
+  }
+  peeked = -1;
+  tcp.stop();
+}
+
+uint8_t BrokerTransport::connected() {
+  if (peeked >= 0) return 1;
+  if (!sslActive) return tcp.connected();
+  return tcp.connected() || mbedtls_ssl_get_bytes_avail(&ssl) > 0;
+}
+#else
+// Không có TLS: mọi thao tác đi thẳng xuống socket TCP
+size_t BrokerTransport::write(const uint8_t* buf, size_t size) {
+  return tcp.write(buf, size);
+}
+
+int BrokerTransport::available() {
+  return tcp.available() + (peeked >= 0 ? 1 : 0);
+}
+
+int BrokerTransport::read(uint8_t* buf, size_t size) {
+  if (size == 0) return 0;
+  if (peeked < 0) return tcp.read(buf, size);
+
+  buf[0] = (uint8_t)peeked;
+  peeked = -1;
+  if (size == 1) return 1;
+  int n = tcp.read(buf + 1, size - 1);
+  return n > 0 ? n + 1 : 1;
+}
+
+void BrokerTransport::flush() {
+  tcp.flush();
+}
+
+void BrokerTransport::stop() {
+  peeked = -1;
+  tcp.stop();
+}
+
+uint8_t BrokerTransport::connected() {
+  return peeked >= 0 || tcp.connected();
+}
+#endif
@@ -9,6 +9,10 @@
 #include <WiFi.h>
 #include <PubSubClient.h>
 #include <ArduinoJson.h>
+#include <Preferences.h>
+#include "laundry_protocol.h"
+#include "machine_config.h"
+#include "broker_transport.h"
 
 // ============================================
 // CẤU HÌNH WIFI & MQTT
@@ -16,76 +20,71 @@
 #define WIFI_SSID         "Wokwi-GUEST"
 #define WIFI_PASSWORD     ""
 
-// HiveMQ Public Broker (Free)
-#define MQTT_SERVER       "broker.hivemq.com"
-#define MQTT_PORT         1883
+// Broker mặc định khi NVS chưa có cấu hình (HiveMQ Public Broker, TCP thường).
+// Máy thật cấu hình qua Serial console, xem phần SERIAL CONSOLE.
+#ifndef BROKER_DEFAULT_HOST
+#define BROKER_DEFAULT_HOST "broker.hivemq.com"
+#endif
+#ifndef BROKER_DEFAULT_PORT
+#define BROKER_DEFAULT_PORT 1883
+#endif
+#ifndef BROKER_DEFAULT_TLS
+#define BROKER_DEFAULT_TLS  false
+#endif
+#if BROKER_DEFAULT_TLS && !defined(BROKER_TLS)
+#error "BROKER_DEFAULT_TLS needs -DBROKER_TLS (see include/broker_transport.h)"
+#endif
+#define BROKER_CA_MAX_LEN   2048   // CA ECDSA P-256 dạng PEM ~700 bytes
 
-// Machine ID - ĐỔI CHO MỖI MÁY: MACHINE_01, MACHINE_02, MACHINE_03, MACHINE_04
-#define MACHINE_ID        "MACHINE_01"
-
-// MQTT Topics
-String TOPIC_STATUS = "laundry/" + String(MACHINE_ID) + "/status";
-String TOPIC_COMMAND = "laundry/" + String(MACHINE_ID) + "/command";
-String TOPIC_ERROR = "laundry/errors";
-String TOPIC_EVENTS = "laundry/events";
-
-// ============================================
-// CẤU HÌNH CHÂN GPIO
-// ============================================
-#define PIN_RELAY_MOTOR   26  
-#define PIN_RELAY_VALVE   32  
-#define PIN_POT_WATER     34  
-#define PIN_POT_DIRT      35  
-#define PIN_DOOR_SWITCH   13  
-#define PIN_BUZZER        15  
-#define PIN_BTN_START     12
-#define PIN_BTN_PAUSE     14
+// MQTT Topics (ghép lúc biên dịch, nằm trong flash)
+const char TOPIC_STATUS[] = LAUNDRY_TOPIC_STATUS(MACHINE_ID);
+const char TOPIC_COMMAND[] = LAUNDRY_TOPIC_COMMAND(MACHINE_ID);
+const char TOPIC_COMMAND_ALL[] = LAUNDRY_TOPIC_COMMAND_ALL;
+const char TOPIC_ERROR[] = LAUNDRY_TOPIC_ERRORS;
+const char TOPIC_EVENTS[] = LAUNDRY_TOPIC_EVENTS;
+const char TOPIC_TELEMETRY[] = LAUNDRY_TOPIC_TELEMETRY(MACHINE_ID);
 
 // ============================================
 // HẰNG SỐ CẤU HÌNH
 // ============================================
-#define WATER_FULL_THRESHOLD      90
-#define WATER_EMPTY_THRESHOLD     5
-#define DIRT_HEAVY_THRESHOLD      3000
+// Chân GPIO, ngưỡng và thời lượng các pha: xem include/machine_config.h
+#ifdef BROKER_TLS
+// TLS handshake (ECDHE + ECDSA verify của mbedtls) chạy trên stack của mqttConnectTask.
+// 8 KB là ước lượng, chưa đo trên ESP32: xem log "mqttConnect stack" sau handshake đầy đủ.
+#define MQTT_CONNECT_STACK        8192
+#else
+#define MQTT_CONNECT_STACK        4096
+#endif
 
-#define FILL_TIMEOUT_MS           10000
-#define MIX_DURATION_MS           5000
-#define HEAVY_WASH_DURATION_MS    15000
-#define NORMAL_WASH_DURATION_MS   8000
-#define SPIN_DURATION_MS          5000
-#define DONE_AUTO_OFF_MS          10000
-#define SENSING_DELAY_MS          2000
+// Dung lượng JsonDocument tính từ schema lúc biên dịch. Giá trị const char*
+// được lưu theo con trỏ nên chỉ cần chỗ cho các node, không cần chỗ cho chuỗi.
+#define STATUS_DOC_SIZE           JSON_OBJECT_SIZE(LAUNDRY_STATUS_FIELDS)
+#define COMMAND_DOC_SIZE          JSON_OBJECT_SIZE(4)    // Zero-copy từ payload
+#define ONLINE_DOC_SIZE           (JSON_OBJECT_SIZE(5) + JSON_OBJECT_SIZE(4) + JSON_OBJECT_SIZE(5))
+#define ERROR_DOC_SIZE            JSON_OBJECT_SIZE(5)
+#define EVENT_DOC_SIZE            JSON_OBJECT_SIZE(5)
+#define HEARTBEAT_DOC_SIZE        (JSON_OBJECT_SIZE(6) + JSON_OBJECT_SIZE(7))
+#define MQTT_PAYLOAD_SIZE         384
 
-#define DEBOUNCE_DELAY_MS         50
-#define BEEP_INTERVAL_MS          500
-#define LOOP_DELAY_MS             20
-#define MQTT_INTERVAL_MS          2000
+#define CONSOLE_LINE_MAX          96
 
 #define LCD_ADDRESS               0x27
 #define LCD_COLS                  20
 #define LCD_ROWS                  4
 
-// ============================================
-// CÁC TRẠNG THÁI MÁY GIẶT
-// ============================================
-enum State { 
-  POWER_OFF, READY, CHECK_SYSTEM, FILLING, MIXING,
-  SENSING, WASHING, DRAINING, SPINNING, PAUSED,
-  ERROR_DOOR, ERROR_WATER, DONE
-};
-
-const char* stateNames[] = {
-  "POWER_OFF", "READY", "CHECK_SYSTEM", "FILLING", "MIXING",
-  "SENSING", "WASHING", "DRAINING", "SPINNING", "PAUSED",
-  "ERROR_DOOR", "ERROR_WATER", "DONE"
-};
+// State / stateNames: xem include/laundry_protocol.h
 
 // ============================================
 // INSTANCES
 // ============================================
 LiquidCrystal_I2C lcd(LCD_ADDRESS, LCD_COLS, LCD_ROWS);
-WiFiClient espClient;
-PubSubClient mqtt(espClient);
+// 2 socket + 2 phiên MQTT: task nền kết nối TCP/TLS và chờ CONNACK trên cặp rảnh,
+// loop() chỉ dùng phiên đang hoạt động (*mqtt)
+BrokerTransport brokerClients[2];
+PubSubClient mqttSessions[2] = { PubSubClient(brokerClients[0]), PubSubClient(brokerClients[1]) };
+PubSubClient* mqtt = &mqttSessions[0];
+Preferences prefs;
+Preferences brokerPrefs;
 
 // ============================================
 // BIẾN TOÀN CỤC
@@ -93,30 +92,133 @@ PubSubClient mqtt(espClient);
 State currentState = POWER_OFF;
 State previousState = READY;
 
-unsigned long phaseStartTime = 0;
-unsigned long savedElapsedTime = 0;
+uint32_t phaseStartTime = 0;
+uint32_t savedElapsedTime = 0;
 unsigned long washDuration = NORMAL_WASH_DURATION_MS;
-unsigned long lastBeepTime = 0;
-unsigned long sensingStartTime = 0;
-unsigned long lastMqttPublish = 0;
+uint32_t lastBeepTime = 0;
+uint32_t sensingStartTime = 0;
+uint32_t lastMqttPublish = 0;
+uint32_t fastPublishStart = 0;
+unsigned long fastPublishDuration = 0;   // 0 = không ở chế độ nhanh
+unsigned long fastPublishInterval = MQTT_FAST_INTERVAL_MS;
+uint32_t lastMqttAttempt = 0;
 
-unsigned long lastStartBtnTime = 0;
-unsigned long lastPauseBtnTime = 0;
+uint32_t lastStartBtnTime = 0;
+uint32_t lastPauseBtnTime = 0;
 bool lastStartBtnState = HIGH;
 bool lastPauseBtnState = HIGH;
 
-String modeName = "NORMAL";
-String currentOrderCode = "";
+bool motorRelayOn = false;
+bool valveRelayOn = false;
+
+// Splash / màn hình POWER OFF chạy theo timer, không block loop()
+bool splashActive = false;
+bool splashBeepPending = false;
+uint32_t splashStart = 0;
+bool backlightOffPending = false;
+uint32_t powerOffTime = 0;
+
+// Boot breakdown (ms kể từ khi khởi động, 0 = chưa tới)
+unsigned long bootLcdMs = 0;
+unsigned long bootReadyMs = 0;
+unsigned long bootWifiMs = 0;
+unsigned long bootMqttMs = 0;
+
+// Cấu hình broker (NVS namespace "broker", xem SERIAL CONSOLE)
+struct BrokerConfig {
+  char host[BROKER_HOST_MAX_LEN + 1];
+  uint16_t port;
+  bool tls;
+};
+
+BrokerConfig brokerConfig;
+bool brokerUsable = true;   // false nếu bật TLS mà thiếu/sai CA: không rơi về TCP thường
+uint32_t netRequestTime = 0;
+
+// Serial console: dòng lệnh đang gõ, buffer CA chỉ cấp phát khi đang dán
+char consoleLine[CONSOLE_LINE_MAX];
+size_t consoleLen = 0;
+char* caInput = NULL;
+size_t caInputLen = 0;
+
+// Bàn giao phiên MQTT giữa mqttConnectTask và loop()
+enum NetConnectState : uint8_t {
+  NET_IDLE, NET_REQUESTED, NET_SESSION_READY, NET_TCP_FAILED, NET_MQTT_FAILED
+};
+volatile NetConnectState netConnectState = NET_IDLE;
+volatile uint8_t netConnectSlot = 1;
+uint8_t activeClient = 0;
+TaskHandle_t mqttConnectTaskHandle = NULL;
+
+const char* modeName = "NORMAL";
+char currentOrderCode[LAUNDRY_ORDER_CODE_MAX_LEN + 1] = "";
+char mqttPayload[MQTT_PAYLOAD_SIZE];
 bool sensingSampled = false;
+uint8_t waterConfirmCount = 0;
 bool errorNotified = false;
+uint32_t lastDoorOpenTime = 0;
+
+// DONE event giữ lại tới khi gửi được (email cho khách phụ thuộc event này)
+bool donePending = false;
+char doneOrderCode[LAUNDRY_ORDER_CODE_MAX_LEN + 1] = "";
+const char* doneMode = "NORMAL";
+unsigned long doneTimestamp = 0;
+unsigned long droppedEvents = 0;
+
+// Telemetry frame buffer (xem phần TELEMETRY FRAMES)
+#define TELEMETRY_FRAME_BYTES     (TELEMETRY_HEADER_BYTES + 4 + (TELEMETRY_MAX_SAMPLES - 1) * 5)
+
+uint8_t telemetryFrame[TELEMETRY_FRAME_BYTES];
+size_t telemetryLen = TELEMETRY_HEADER_BYTES;
+uint8_t telemetryCount = 0;
+uint16_t telemetrySeq = 0;
+uint32_t telemetryFrameStart = 0;
+uint32_t nextTelemetrySample = 0;
+int telemetryLastWater = 0;
+int telemetryLastDirt = 0;
+
+static_assert(TELEMETRY_FRAME_MS / TELEMETRY_SAMPLE_MS <= TELEMETRY_MAX_SAMPLES,
+              "Telemetry frame cannot hold TELEMETRY_FRAME_MS worth of samples");
+
+// Bộ đếm bảo trì (xem phần PERSISTENT COUNTERS)
+struct DeviceCounters {
+  uint32_t cyclesNormal;
+  uint32_t cyclesHeavy;
+  uint32_t motorOnSec;
+  uint32_t valveOnSec;
+  uint32_t motorToggles;
+  uint32_t valveToggles;
+};
+
+struct CounterRecord {
+  uint32_t seq;
+  DeviceCounters counters;
+  uint32_t crc;
+};
+
+DeviceCounters counters = {};
+uint32_t counterSeq = 0;
+bool countersDirty = false;
+uint32_t lastCounterFlush = 0;
+uint32_t lastHeartbeat = 0;
+uint32_t motorOnSince = 0;
+uint32_t valveOnSince = 0;
+unsigned long motorOnRemainderMs = 0;
+unsigned long valveOnRemainderMs = 0;
 
 // ============================================
 // FORWARD DECLARATIONS
 // ============================================
 void stopAllRelays();
+void setOrderCode(const char* code);
+bool publishJson(const char* topic, const JsonDocument& doc);
+void sendStatusSnapshot();
+void writeRelay(uint8_t pin, bool on);
 void beep(int freq, int dur);
 int readWaterLevel();
 int readDirtLevel();
+bool readDoorOpen();
+void flushPendingDone();
 void powerOff();
 void powerOn();
 int calculateProgress();
@@ -124,39 +226,33 @@ int calculateProgress();
 // ============================================
 // WIFI SETUP
 // ============================================
+// Không chờ kết nối: WiFi tự kết nối trong nền, loop() theo dõi qua maintainNetwork()
 void setupWifi() {
-  Serial.print("Connecting to WiFi");
-  lcd.clear();
-  lcd.setCursor(0, 0);
-  lcd.print("Connecting WiFi...");
-  
+  Serial.println("Connecting to WiFi (background)");
+  WiFi.mode(WIFI_STA);
+  WiFi.setAutoReconnect(true);
   WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
-  
-  int attempts = 0;
-  while (WiFi.status() != WL_CONNECTED && attempts < 30) {
-    delay(500);
-    Serial.print(".");
-    lcd.setCursor(attempts % 20, 1);
-    lcd.print(".");
-    attempts++;
-  }
-  
-  if (WiFi.status() == WL_CONNECTED) {
-    Serial.println("\nWiFi Connected!");
-    Serial.print("IP: ");
-    Serial.println(WiFi.localIP());
-    lcd.clear();
-    lcd.setCursor(0, 0);
-    lcd.print("WiFi Connected!");
-    lcd.setCursor(0, 1);
-    lcd.print(WiFi.localIP());
-    delay(1500);
-  } else {
-    Serial.println("\nWiFi Failed!");
-    lcd.clear();
-    lcd.setCursor(0, 0);
-    lcd.print("WiFi Failed!");
-    delay(1500);
+}
+
+// Kết nối broker (DNS + TCP, TLS handshake nếu bật, CONNECT rồi chờ CONNACK tới
+// MQTT_SOCKET_TIMEOUT_S) tốn tới vài giây -> chạy trong task riêng để loop() vẫn
+// kiểm tra cửa/nút bấm. Task chỉ chạm vào socket + phiên mà loop() không dùng,
+// loop() nhận phiên đã kết nối qua adoptMqttSession().
+void mqttConnectTask(void* param) {
+  for (;;) {
+    if (netConnectState == NET_REQUESTED) {
+      uint8_t slot = netConnectSlot;
+      BrokerTransport& client = brokerClients[slot];
+      client.stop();
+      if (!client.connect(brokerConfig.host, brokerConfig.port)) {
+        netConnectState = NET_TCP_FAILED;
+      } else {
+        char clientId[40];
+        snprintf(clientId, sizeof(clientId), "ESP32_%s_%ld", MACHINE_ID, random(1000));
+        netConnectState = mqttSessions[slot].connect(clientId) ? NET_SESSION_READY : NET_MQTT_FAILED;
+      }
+    }
+    vTaskDelay(pdMS_TO_TICKS(20));
   }
 }
 
@@ -164,16 +260,19 @@ void setupWifi() {
 // MQTT CALLBACK - Nhận lệnh từ Admin
 // ============================================
 void mqttCallback(char* topic, byte* payload, unsigned int length) {
-  String message = "";
-  for (unsigned int i = 0; i < length; i++) {
-    message += (char)payload[i];
+  if (length > MQTT_COMMAND_MAX_LEN) {
+    Serial.print("MQTT command too large: ");
+    Serial.println(length);
+    return;
   }
   
   Serial.print("MQTT Received: ");
-  Serial.println(message);
+  Serial.write(payload, length);
+  Serial.println();
   
-  StaticJsonDocument<256> doc;
-  DeserializationError error = deserializeJson(doc, message);
+  // Parse thẳng trên buffer của PubSubClient (zero-copy), không tạo String
+  StaticJsonDocument<COMMAND_DOC_SIZE> doc;
+  DeserializationError error = deserializeJson(doc, (char*)payload, length);
   
   if (error) {
     Serial.println("JSON parse error");
@@ -181,9 +280,34 @@ void mqttCallback(char* topic, byte* payload, unsigned int length) {
   }
   
   const char* command = doc["command"];
+  if (command == NULL) {
+    Serial.println("Missing command");
+    return;
+  }
+  
+  // Topic broadcast chỉ nhận GET_STATUS (không cho điều khiển cả tiệm 1 lúc)
+  if (strcmp(topic, TOPIC_COMMAND_ALL) == 0 && strcmp(command, "GET_STATUS") != 0) {
+    return;
+  }
   
+  // Trả snapshot ngay (backend vừa khởi động / dashboard vừa mở)
+  if (strcmp(command, "GET_STATUS") == 0) {
+    sendStatusSnapshot();
+  }
+  // Tăng tần suất publish tạm thời (lease, admin gửi lại để gia hạn)
+  else if (strcmp(command, "SUBSCRIBE_FAST") == 0) {
+    unsigned long duration = doc["durationMs"] | (unsigned long)MQTT_FAST_DEFAULT_MS;
+    unsigned long interval = doc["intervalMs"] | (unsigned long)MQTT_FAST_INTERVAL_MS;
+    fastPublishDuration = min(duration, (unsigned long)MQTT_FAST_MAX_MS);
+    fastPublishInterval = max(interval, (unsigned long)MQTT_FAST_MIN_INTERVAL_MS);
+    fastPublishStart = millis();
+    if (fastPublishDuration > 0) sendStatusSnapshot();
+    Serial.print(">>> Fast status for ");
+    Serial.print(fastPublishDuration);
+    Serial.println("ms");
+  }
   // Lệnh PAUSE từ Admin
-  if (strcmp(command, "PAUSE") == 0) {
+  else if (strcmp(command, "PAUSE") == 0) {
     if (currentState != POWER_OFF && currentState != READY && 
         currentState != PAUSED && currentState != DONE &&
         currentState != ERROR_DOOR && currentState != ERROR_WATER) {
@@ -211,12 +335,13 @@ void mqttCallback(char* topic, byte* payload, unsigned int length) {
     if (currentState == READY) {
       const char* orderCode = doc["orderCode"];
       if (orderCode) {
-        currentOrderCode = String(orderCode);
+        setOrderCode(orderCode);
       }
       currentState = CHECK_SYSTEM;
       phaseStartTime = millis();
       beep(2000, 100);
-      Serial.println(">>> Remote START - Order: " + currentOrderCode);
+      Serial.print(">>> Remote START - Order: ");
+      Serial.println(currentOrderCode);
       lcd.clear();
     }
   }
@@ -224,14 +349,14 @@ void mqttCallback(char* topic, byte* payload, unsigned int length) {
   else if (strcmp(command, "SET_ORDER") == 0) {
     const char* orderCode = doc["orderCode"];
     if (orderCode) {
-      currentOrderCode = String(orderCode);
-      Serial.println(">>> Order assigned: " + currentOrderCode);
+      setOrderCode(orderCode);
+      Serial.print(">>> Order assigned: ");
+      Serial.println(currentOrderCode);
     }
   }
   // Lệnh RESET từ Admin
   else if (strcmp(command, "RESET") == 0) {
     powerOff();
-    delay(500);
     powerOn();
     Serial.println(">>> Remote RESET");
   }
@@ -240,50 +365,124 @@ void mqttCallback(char* topic, byte* payload, unsigned int length) {
 // ============================================
 // MQTT CONNECT
 // ============================================
-void connectMqtt() {
-  if (mqtt.connected()) return;
+// Phiên trong slot netConnectSlot đã qua CONNACK (mqttConnectTask): loop() dùng
+// nó từ đây, subscribe + báo ONLINE. Không có lệnh nào ở đây chờ broker.
+void adoptMqttSession() {
+  mqtt = &mqttSessions[netConnectSlot];
+  activeClient = netConnectSlot;
+  const BrokerHandshakeStats& hs = brokerClients[activeClient].lastHandshake();
+  unsigned long connectMs = millis() - netRequestTime;
+  Serial.printf("Connected! tcp=%lums tls=%lums (%s) total=%lums\n",
+                (unsigned long)hs.tcpMs, (unsigned long)hs.handshakeMs,
+                !hs.tls ? "plain" : (hs.resumed ? "resumed" : "full"), connectMs);
+  if (hs.tls && !hs.resumed) {
+    // Handshake đầy đủ là lúc task dùng nhiều stack nhất (ESP-IDF tính bằng byte)
+    Serial.printf("mqttConnect stack: %u of %u bytes never used\n",
+                  (unsigned)uxTaskGetStackHighWaterMark(mqttConnectTaskHandle),
+                  (unsigned)MQTT_CONNECT_STACK);
+  }
+  mqtt->subscribe(TOPIC_COMMAND);
+  mqtt->subscribe(TOPIC_COMMAND_ALL);
   
-  Serial.print("Connecting MQTT...");
-  String clientId = "ESP32_" + String(MACHINE_ID) + "_" + String(random(1000));
+  bool firstConnect = (bootMqttMs == 0);
+  if (firstConnect) {
+    bootMqttMs = millis();
+    Serial.printf("Boot breakdown: lcd=%lums ready=%lums wifi=%lums mqtt=%lums\n",
+                  bootLcdMs, bootReadyMs, bootWifiMs, bootMqttMs);
+  }
   
-  if (mqtt.connect(clientId.c_str())) {
-    Serial.println("Connected!");
-    mqtt.subscribe(TOPIC_COMMAND.c_str());
-    
-    // Publish online status
-    StaticJsonDocument<128> doc;
-    doc["machineId"] = MACHINE_ID;
-    doc["event"] = "ONLINE";
-    doc["timestamp"] = millis();
-    String json;
-    serializeJson(doc, json);
-    mqtt.publish(TOPIC_EVENTS.c_str(), json.c_str());
-  } else {
-    Serial.print("Failed, rc=");
-    Serial.println(mqtt.state());
+  // Publish online status
+  StaticJsonDocument<ONLINE_DOC_SIZE> doc;
+  doc["machineId"] = MACHINE_ID;
+  doc["event"] = "ONLINE";
+  doc["timestamp"] = millis();
+  if (firstConnect) {
+    JsonObject boot = doc.createNestedObject("boot");
+    boot["lcdMs"] = bootLcdMs;
+    boot["readyMs"] = bootReadyMs;
+    boot["wifiMs"] = bootWifiMs;
+    boot["mqttMs"] = bootMqttMs;
+  }
+  JsonObject net = doc.createNestedObject("net");
+  net["tls"] = hs.tls;
+  net["resumed"] = hs.resumed;
+  net["tcpMs"] = hs.tcpMs;
+  net["tlsMs"] = hs.handshakeMs;
+  net["connectMs"] = connectMs;
+  publishJson(TOPIC_EVENTS, doc);
+  flushPendingDone();
+}
+
+// ============================================
+// NETWORK MAINTENANCE - gọi mỗi vòng loop(), không block
+// ============================================
+void maintainNetwork() {
+  if (WiFi.status() != WL_CONNECTED) return;
+  
+  if (bootWifiMs == 0) {
+    bootWifiMs = millis();
+    Serial.print("WiFi Connected! IP: ");
+    Serial.println(WiFi.localIP());
+  }
+  if (!brokerUsable) return;
+  
+  if (mqtt->connected()) {
+    mqtt->loop();
+    return;
+  }
+  
+  if (netConnectState == NET_SESSION_READY) {
+    adoptMqttSession();
+    netConnectState = NET_IDLE;
+  } else if (netConnectState == NET_TCP_FAILED) {
+    netConnectState = NET_IDLE;
+    Serial.println("MQTT TCP connect failed");
+  } else if (netConnectState == NET_MQTT_FAILED) {
+    netConnectState = NET_IDLE;
+    Serial.print("MQTT connect failed, rc=");
+    Serial.println(mqttSessions[netConnectSlot].state());
+  } else if (netConnectState == NET_IDLE &&
+             (lastMqttAttempt == 0 || millis() - lastMqttAttempt >= MQTT_RETRY_MS)) {
+    lastMqttAttempt = millis();
+    netRequestTime = lastMqttAttempt;
+    netConnectSlot = 1 - activeClient;
+    netConnectState = NET_REQUESTED;
   }
 }
 
 // ============================================
 // PUBLISH STATUS TO MQTT
 // ============================================
+unsigned long statusInterval() {
+  if (fastPublishDuration > 0) {
+    if (millis() - fastPublishStart < fastPublishDuration) return fastPublishInterval;
+    fastPublishDuration = 0;   // Hết lease
+  }
+  return MQTT_INTERVAL_MS;
+}
+
 void publishStatus() {
-  if (millis() - lastMqttPublish < MQTT_INTERVAL_MS) return;
+  if (millis() - lastMqttPublish < statusInterval()) return;
+  sendStatusSnapshot();
+}
+
+// Gửi snapshot đầy đủ ngay lập tức, lần gửi định kỳ tiếp theo tính lại từ đây
+void sendStatusSnapshot() {
   lastMqttPublish = millis();
   
-  if (!mqtt.connected()) return;
+  if (!mqtt->connected()) return;
   
   int waterLevel = readWaterLevel();
   int progress = calculateProgress();
   
-  StaticJsonDocument<512> doc;
+  StaticJsonDocument<STATUS_DOC_SIZE> doc;
   doc["machineId"] = MACHINE_ID;
   doc["state"] = stateNames[currentState];
   doc["progress"] = progress;
   doc["waterLevel"] = waterLevel;
   doc["mode"] = modeName;
-  doc["orderCode"] = currentOrderCode;
-  doc["doorOpen"] = (digitalRead(PIN_DOOR_SWITCH) == HIGH);
+  doc["orderCode"] = (const char*)currentOrderCode;
+  doc["doorOpen"] = readDoorOpen();
   doc["timestamp"] = millis();
   
   if (currentState == ERROR_DOOR) {
@@ -292,49 +491,293 @@ void publishStatus() {
     doc["errorCode"] = "WATER_TIMEOUT";
   }
   
-  String json;
-  serializeJson(doc, json);
-  mqtt.publish(TOPIC_STATUS.c_str(), json.c_str());
+  publishJson(TOPIC_STATUS, doc);
 }
 
 // ============================================
 // PUBLISH ERROR TO ADMIN
 // ============================================
 void publishError(const char* errorType, const char* errorMessage) {
-  if (!mqtt.connected()) return;
+  if (!mqtt->connected()) {
+    droppedEvents++;
+    return;
+  }
   
-  StaticJsonDocument<256> doc;
+  StaticJsonDocument<ERROR_DOC_SIZE> doc;
   doc["machineId"] = MACHINE_ID;
-  doc["orderCode"] = currentOrderCode;
+  doc["orderCode"] = (const char*)currentOrderCode;
   doc["errorType"] = errorType;
   doc["errorMessage"] = errorMessage;
   doc["timestamp"] = millis();
   
-  String json;
-  serializeJson(doc, json);
-  mqtt.publish(TOPIC_ERROR.c_str(), json.c_str());
+  publishJson(TOPIC_ERROR, doc);
   
-  Serial.println("Error published: " + String(errorType));
+  Serial.print("Error published: ");
+  Serial.println(errorType);
 }
 
 // ============================================
 // PUBLISH DONE EVENT
 // ============================================
+// Nếu đang mất MQTT, event được giữ lại và gửi trong adoptMqttSession()
 void publishDone() {
-  if (!mqtt.connected()) return;
+  if (donePending) droppedEvents++;   // Chu trình trước vẫn chưa gửi được
   
-  StaticJsonDocument<256> doc;
+  donePending = true;
+  strlcpy(doneOrderCode, currentOrderCode, sizeof(doneOrderCode));
+  doneMode = modeName;
+  doneTimestamp = millis();
+  
+  flushPendingDone();
+}
+
+void flushPendingDone() {
+  if (!donePending || !mqtt->connected()) return;
+  
+  StaticJsonDocument<EVENT_DOC_SIZE> doc;
   doc["machineId"] = MACHINE_ID;
-  doc["orderCode"] = currentOrderCode;
+  doc["orderCode"] = (const char*)doneOrderCode;
   doc["event"] = "DONE";
-  doc["mode"] = modeName;
-  doc["timestamp"] = millis();
+  doc["mode"] = doneMode;
+  doc["timestamp"] = doneTimestamp;
   
-  String json;
-  serializeJson(doc, json);
-  mqtt.publish(TOPIC_EVENTS.c_str(), json.c_str());
-  
-  Serial.println("Done event published");
+  if (publishJson(TOPIC_EVENTS, doc)) {
+    donePending = false;
+    Serial.println("Done event published");
+  }
+}
+
+// ============================================
+// PERSISTENT COUNTERS (NVS)
+// ============================================
+// Hai slot "ctrA"/"ctrB" ghi luân phiên, mỗi bản ghi có seq + CRC32.
+// Mất điện giữa lúc ghi chỉ làm hỏng slot đang ghi, slot còn lại vẫn hợp lệ.
+// Cập nhật chỉ cộng dồn trong RAM; flash được ghi khi máy rảnh
+// (READY/DONE/PAUSED/POWER_OFF) và khi kết thúc chu trình giặt.
+// Ghi NVS tắt cache flash, loop() đứng tới vài chục ms (xoá sector): không
+// bao giờ ghi khi relay đang bật, kể cả lúc quá COUNTER_FORCE_FLUSH_MS.
+const char* const COUNTER_SLOTS[2] = { "ctrA", "ctrB" };
+
+uint32_t crc32(const uint8_t* data, size_t len) {
+  uint32_t crc = 0xFFFFFFFF;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= data[i];
+    for (int b = 0; b < 8; b++) {
+      crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
+bool readCounterSlot(int slot, CounterRecord* rec) {
+  if (prefs.getBytes(COUNTER_SLOTS[slot], rec, sizeof(*rec)) != sizeof(*rec)) return false;
+  return rec->crc == crc32((const uint8_t*)rec, offsetof(CounterRecord, crc));
+}
+
+void loadCounters() {
+  prefs.begin("counters", false);
+
+  CounterRecord a, b;
+  bool okA = readCounterSlot(0, &a);
+  bool okB = readCounterSlot(1, &b);
+
+  if (okA && (!okB || (int32_t)(a.seq - b.seq) > 0)) {
+    counters = a.counters;
+    counterSeq = a.seq;
+  } else if (okB) {
+    counters = b.counters;
+    counterSeq = b.seq;
+  }
+
+  Serial.print("Counters loaded, seq=");
+  Serial.println(counterSeq);
+}
+
+// Cộng thời gian relay đang bật vào bộ đếm (giữ phần lẻ ms trong RAM)
+void accumulateRelayTime(uint32_t now) {
+  if (motorRelayOn) {
+    motorOnRemainderMs += now - motorOnSince;
+    motorOnSince = now;
+  }
+  if (valveRelayOn) {
+    valveOnRemainderMs += now - valveOnSince;
+    valveOnSince = now;
+  }
+  if (motorOnRemainderMs >= 1000) {
+    counters.motorOnSec += motorOnRemainderMs / 1000;
+    motorOnRemainderMs %= 1000;
+    countersDirty = true;
+  }
+  if (valveOnRemainderMs >= 1000) {
+    counters.valveOnSec += valveOnRemainderMs / 1000;
+    valveOnRemainderMs %= 1000;
+    countersDirty = true;
+  }
+}
+
+// Gọi từ writeRelay() trước khi cập nhật trạng thái relay
+void countRelayChange(uint8_t pin, bool on) {
+  uint32_t now = millis();
+  accumulateRelayTime(now);
+
+  if (pin == PIN_RELAY_MOTOR && on != motorRelayOn) {
+    counters.motorToggles++;
+    motorOnSince = now;
+    countersDirty = true;
+  } else if (pin == PIN_RELAY_VALVE && on != valveRelayOn) {
+    counters.valveToggles++;
+    valveOnSince = now;
+    countersDirty = true;
+  }
+}
+
+void countCycleDone() {
+  if (strcmp(modeName, "HEAVY") == 0) counters.cyclesHeavy++;
+  else counters.cyclesNormal++;
+  countersDirty = true;
+}
+
+void flushCounters() {
+  accumulateRelayTime(millis());
+  lastCounterFlush = millis();
+  if (!countersDirty) return;
+
+  CounterRecord rec;
+  rec.seq = counterSeq + 1;
+  rec.counters = counters;
+  rec.crc = crc32((const uint8_t*)&rec, offsetof(CounterRecord, crc));
+
+  if (prefs.putBytes(COUNTER_SLOTS[rec.seq & 1], &rec, sizeof(rec)) == sizeof(rec)) {
+    counterSeq = rec.seq;
+    countersDirty = false;
+  } else {
+    Serial.println("Counter flush failed");
+  }
+}
+
+void maintainCounters() {
+  // Quá hạn thì ghi ở vòng đầu tiên cả 2 relay tắt (giữa các pha, PAUSED, DONE)
+  if (motorRelayOn || valveRelayOn) return;
+
+  uint32_t sinceFlush = millis() - lastCounterFlush;
+  bool idle = (currentState == READY || currentState == DONE ||
+               currentState == PAUSED || currentState == POWER_OFF);
+
+  if ((idle && sinceFlush >= COUNTER_FLUSH_MS) || sinceFlush >= COUNTER_FORCE_FLUSH_MS) {
+    flushCounters();
+  }
+}
+
+// ============================================
+// PUBLISH HEARTBEAT (bộ đếm bảo trì)
+// ============================================
+void publishHeartbeat() {
+  if (millis() - lastHeartbeat < HEARTBEAT_INTERVAL_MS) return;
+  lastHeartbeat = millis();
+
+  if (!mqtt->connected()) return;
+
+  accumulateRelayTime(millis());
+
+  StaticJsonDocument<HEARTBEAT_DOC_SIZE> doc;
+  doc["machineId"] = MACHINE_ID;
+  doc["event"] = "HEARTBEAT";
+  doc["uptime"] = millis();
+  doc["droppedEvents"] = droppedEvents;
+  JsonObject c = doc.createNestedObject("counters");
+  c["cyclesNormal"] = counters.cyclesNormal;
+  c["cyclesHeavy"] = counters.cyclesHeavy;
+  c["motorOnSec"] = counters.motorOnSec;
+  c["valveOnSec"] = counters.valveOnSec;
+  c["motorToggles"] = counters.motorToggles;
+  c["valveToggles"] = counters.valveToggles;
+  c["seq"] = counterSeq;
+  doc["timestamp"] = millis();
+
+  publishJson(TOPIC_EVENTS, doc);
+}
+
+// ============================================
+// TELEMETRY FRAMES - Lấy mẫu 10 Hz, gửi theo lô
+// ============================================
+// Frame nhị phân (little-endian) trên TOPIC_TELEMETRY:
+//   [0]     version
+//   [1..2]  seq (tăng cả khi frame bị bỏ do mất MQTT -> phía nhận thấy gap)
+//   [3..6]  t0 = millis() của mẫu đầu tiên
+//   [7..8]  chu kỳ lấy mẫu (ms), mẫu thứ i ở t0 + i * chu kỳ
+//   [9]     số mẫu
+// Mẫu đầu:  flags, water (0-100), dirt (u16)
+// Mẫu sau:  flags, dWater (int8), dDirt (zigzag varint)
+// flags: bit0 motor relay, bit1 valve relay, bit2 door open, bit3-7 state
+void telemetryPutVarint(uint32_t value) {
+  while (value >= 0x80) {
+    telemetryFrame[telemetryLen++] = (value & 0x7F) | 0x80;
+    value >>= 7;
+  }
+  telemetryFrame[telemetryLen++] = value;
+}
+
+void flushTelemetry() {
+  if (telemetryCount == 0) return;
+
+  telemetryFrame[0] = TELEMETRY_VERSION;
+  telemetryFrame[1] = telemetrySeq & 0xFF;
+  telemetryFrame[2] = telemetrySeq >> 8;
+  for (int i = 0; i < 4; i++) {
+    telemetryFrame[3 + i] = (telemetryFrameStart >> (8 * i)) & 0xFF;
+  }
+  telemetryFrame[7] = TELEMETRY_SAMPLE_MS & 0xFF;
+  telemetryFrame[8] = TELEMETRY_SAMPLE_MS >> 8;
+  telemetryFrame[9] = telemetryCount;
+
+  if (mqtt->connected()) {
+    mqtt->publish(TOPIC_TELEMETRY, telemetryFrame, telemetryLen);
+  }
+
+  telemetrySeq++;
+  telemetryCount = 0;
+  telemetryLen = TELEMETRY_HEADER_BYTES;
+}
+
+void sampleTelemetry() {
+  uint32_t now = millis();
+  if ((int32_t)(now - nextTelemetrySample) < 0) return;
+
+  // Trễ quá 1 chu kỳ (vừa bật máy, loop bị block) -> đóng frame cũ,
+  // bắt đầu lưới thời gian mới để timestamp ngầm định vẫn đúng
+  if (now - nextTelemetrySample >= TELEMETRY_SAMPLE_MS) {
+    flushTelemetry();
+    nextTelemetrySample = now;
+  }
+  uint32_t sampleTime = nextTelemetrySample;
+  nextTelemetrySample += TELEMETRY_SAMPLE_MS;
+
+  int water = readWaterLevel();
+  int dirt = readDirtLevel();
+  uint8_t flags = (motorRelayOn ? TELEMETRY_FLAG_MOTOR : 0) |
+                  (valveRelayOn ? TELEMETRY_FLAG_VALVE : 0) |
+                  (readDoorOpen() ? TELEMETRY_FLAG_DOOR : 0) |
+                  (currentState << TELEMETRY_STATE_SHIFT);
+
+  telemetryFrame[telemetryLen++] = flags;
+  if (telemetryCount == 0) {
+    telemetryFrameStart = sampleTime;
+    telemetryFrame[telemetryLen++] = water;
+    telemetryFrame[telemetryLen++] = dirt & 0xFF;
+    telemetryFrame[telemetryLen++] = dirt >> 8;
+  } else {
+    int dDirt = dirt - telemetryLastDirt;
+    telemetryFrame[telemetryLen++] = (uint8_t)(int8_t)(water - telemetryLastWater);
+    telemetryPutVarint(((uint32_t)dDirt << 1) ^ (uint32_t)(dDirt >> 31));
+  }
+  telemetryLastWater = water;
+  telemetryLastDirt = dirt;
+  telemetryCount++;
+
+  if ((unsigned long)telemetryCount * TELEMETRY_SAMPLE_MS >= TELEMETRY_FRAME_MS ||
+      telemetryCount >= TELEMETRY_MAX_SAMPLES) {
+    flushTelemetry();
+  }
 }
 
 // ============================================
@@ -374,24 +817,61 @@ int calculateProgress() {
 // ============================================
 // UTILITY FUNCTIONS
 // ============================================
+// Serialize vào buffer tĩnh dùng chung, tránh cấp phát String trên heap
+bool publishJson(const char* topic, const JsonDocument& doc) {
+  size_t len = serializeJson(doc, mqttPayload, sizeof(mqttPayload));
+  return mqtt->publish(topic, (const uint8_t*)mqttPayload, len);
+}
+
+void setOrderCode(const char* code) {
+  strlcpy(currentOrderCode, code, sizeof(currentOrderCode));
+}
+
 void beep(int freq, int dur) {
   tone(PIN_BUZZER, freq, dur);
 }
 
+void writeRelay(uint8_t pin, bool on) {
+  countRelayChange(pin, on);
+  digitalWrite(pin, on ? HIGH : LOW);
+  if (pin == PIN_RELAY_MOTOR) motorRelayOn = on;
+  else if (pin == PIN_RELAY_VALVE) valveRelayOn = on;
+}
+
 void stopAllRelays() {
-  digitalWrite(PIN_RELAY_MOTOR, LOW);
-  digitalWrite(PIN_RELAY_VALVE, LOW);
+  writeRelay(PIN_RELAY_MOTOR, LOW);
+  writeRelay(PIN_RELAY_VALVE, LOW);
 }
 
+// Median của 3 lần đọc: loại spike ADC đơn lẻ (nhiễu khi relay đóng/ngắt)
 int readWaterLevel() {
-  return map(analogRead(PIN_POT_WATER), 0, 4095, 0, 100);
+  int a = analogRead(PIN_POT_WATER);
+  int b = analogRead(PIN_POT_WATER);
+  int c = analogRead(PIN_POT_WATER);
+  int median = max(min(a, b), min(max(a, b), c));
+  return map(median, 0, 4095, 0, 100);
+}
+
+// Điều kiện mực nước phải đúng WATER_CONFIRM_READS lần liên tiếp mới chuyển pha
+bool waterLevelConfirmed(bool condition) {
+  if (!condition) {
+    waterConfirmCount = 0;
+    return false;
+  }
+  if (++waterConfirmCount < WATER_CONFIRM_READS) return false;
+  waterConfirmCount = 0;
+  return true;
 }
 
 int readDirtLevel() {
   return analogRead(PIN_POT_DIRT);
 }
 
-bool readButtonDebounced(int pin, bool* lastState, unsigned long* lastTime) {
+bool readDoorOpen() {
+  return digitalRead(PIN_DOOR_SWITCH) == HIGH;
+}
+
+bool readButtonDebounced(int pin, bool* lastState, uint32_t* lastTime) {
   bool reading = digitalRead(pin);
   if (*lastState == HIGH && reading == LOW) {
     if (millis() - *lastTime > DEBOUNCE_DELAY_MS) {
@@ -422,22 +902,27 @@ void drawProgressBar(int row, int percent, const char* label) {
 void powerOff() {
   stopAllRelays();
   noTone(PIN_BUZZER);
+  flushTelemetry();
+  flushCounters();
   lcd.clear();
   lcd.setCursor(5, 1);
   lcd.print("POWER OFF");
-  delay(1000);
-  lcd.noBacklight();
-  lcd.clear();
+  backlightOffPending = true;   // Tắt đèn nền sau POWER_OFF_MSG_MS (serviceDisplayTimers)
+  powerOffTime = millis();
+  splashActive = false;
+  splashBeepPending = false;
   
   currentState = POWER_OFF;
-  currentOrderCode = "";
+  currentOrderCode[0] = '\0';
   modeName = "NORMAL";
   washDuration = NORMAL_WASH_DURATION_MS;
   sensingSampled = false;
   errorNotified = false;
 }
 
+// Splash không block: máy vào READY ngay, nút bấm có tác dụng lập tức
 void powerOn() {
+  backlightOffPending = false;
   lcd.backlight();
   lcd.clear();
   lcd.setCursor(2, 0);
@@ -445,15 +930,32 @@ void powerOn() {
   lcd.setCursor(3, 1);
   lcd.print(MACHINE_ID);
   beep(1000, 100);
-  delay(150);
-  beep(2000, 200);
-  delay(1000);
-  lcd.clear();
+  splashActive = true;
+  splashBeepPending = true;
+  splashStart = millis();
   currentState = READY;
   sensingSampled = false;
   errorNotified = false;
 }
 
+void serviceDisplayTimers() {
+  uint32_t now = millis();
+  
+  if (splashBeepPending && now - splashStart >= SPLASH_BEEP_DELAY_MS) {
+    splashBeepPending = false;
+    beep(2000, 200);
+  }
+  if (splashActive && now - splashStart >= SPLASH_DURATION_MS) {
+    splashActive = false;
+    if (currentState == READY) lcd.clear();
+  }
+  if (backlightOffPending && now - powerOffTime >= POWER_OFF_MSG_MS) {
+    backlightOffPending = false;
+    lcd.noBacklight();
+    lcd.clear();
+  }
+}
+
 // ============================================
 // BUTTON HANDLERS
 // ============================================
@@ -492,8 +994,11 @@ void handlePauseButton() {
   }
 }
 
+// Cửa mở: ngắt relay ngay lập tức. Cửa đóng: chờ DOOR_CLOSE_DEBOUNCE_MS để
+// một lần rung tiếp điểm không tạo nhiều lần ERROR_DOOR liên tiếp.
 void checkDoorStatus() {
-  bool doorOpen = (digitalRead(PIN_DOOR_SWITCH) == HIGH);
+  bool doorOpen = readDoorOpen();
+  if (doorOpen) lastDoorOpenTime = millis();
   
   if (doorOpen && currentState != POWER_OFF && currentState != READY && 
       currentState != PAUSED && currentState != DONE && 
@@ -503,19 +1008,149 @@ void checkDoorStatus() {
     currentState = ERROR_DOOR;
     stopAllRelays();
     errorNotified = false;
-  } else if (!doorOpen && currentState == ERROR_DOOR) {
+  } else if (!doorOpen && currentState == ERROR_DOOR &&
+             millis() - lastDoorOpenTime >= DOOR_CLOSE_DEBOUNCE_MS) {
     currentState = PAUSED;
     lcd.clear();
   }
 }
 
+// ============================================
+// BROKER CONFIG + SERIAL CONSOLE
+// ============================================
+// Cấu hình broker nằm trong NVS, áp dụng ở lần khởi động sau:
+//   broker                            in cấu hình hiện tại
+//   broker <host> <port> <plain|tls>  lưu host/port/kiểu kết nối
+//   ca                                dán CA (PEM), kết thúc ở dòng END CERTIFICATE
+//   reboot
+void printBrokerConfig() {
+  Serial.printf("Broker: %s:%u %s%s\n", brokerConfig.host, brokerConfig.port,
+                brokerConfig.tls ? "TLS" : "plain", brokerUsable ? "" : " (disabled)");
+}
+
+void loadBrokerConfig() {
+  brokerPrefs.begin("broker", true);
+  if (brokerPrefs.getString("host", brokerConfig.host, sizeof(brokerConfig.host)) == 0) {
+    strlcpy(brokerConfig.host, BROKER_DEFAULT_HOST, sizeof(brokerConfig.host));
+  }
+  brokerConfig.port = brokerPrefs.getUShort("port", BROKER_DEFAULT_PORT);
+  brokerConfig.tls = brokerPrefs.getBool("tls", BROKER_DEFAULT_TLS);
+
+  if (brokerConfig.tls) {
+    // PEM chỉ cần lúc parse: mbedtls giữ bản đã decode, buffer trả lại heap
+    char* ca = (char*)malloc(BROKER_CA_MAX_LEN);
+    size_t caLen = ca ? brokerPrefs.getString("ca", ca, BROKER_CA_MAX_LEN) : 0;
+    if (caLen == 0) {
+      Serial.println("Broker TLS enabled but no CA stored (use 'ca')");
+      brokerUsable = false;
+    } else {
+      brokerUsable = BrokerTransport::setupTls(ca);
+    }
+    free(ca);
+  }
+  brokerPrefs.end();
+  printBrokerConfig();
+}
+
+// Dòng PEM dán vào sau lệnh 'ca'
+void appendCaLine(const char* line) {
+  size_t len = strlen(line);
+  if (caInputLen + len + 2 > BROKER_CA_MAX_LEN) {
+    Serial.println("CA too large, discarded");
+    free(caInput);
+    caInput = NULL;
+    return;
+  }
+  memcpy(caInput + caInputLen, line, len);
+  caInputLen += len;
+  caInput[caInputLen++] = '\n';
+  caInput[caInputLen] = '\0';
+
+  if (strstr(line, "-----END CERTIFICATE-----") != NULL) {
+    brokerPrefs.begin("broker", false);
+    brokerPrefs.putString("ca", caInput);
+    brokerPrefs.end();
+    Serial.printf("CA saved (%u bytes), reboot to apply\n", (unsigned)caInputLen);
+    free(caInput);
+    caInput = NULL;
+  }
+}
+
+void handleConsoleLine(char* line) {
+  if (caInput != NULL) {
+    appendCaLine(line);
+    return;
+  }
+
+  const char* cmd = strtok(line, " ");
+  if (cmd == NULL) return;
+
+  if (strcmp(cmd, "broker") == 0) {
+    const char* host = strtok(NULL, " ");
+    const char* port = strtok(NULL, " ");
+    const char* mode = strtok(NULL, " ");
+    if (host == NULL) {
+      printBrokerConfig();
+      return;
+    }
+    long portNum = port ? atol(port) : 0;
+    bool tls = mode != NULL && strcmp(mode, "tls") == 0;
+    if (mode == NULL || strlen(host) > BROKER_HOST_MAX_LEN || portNum <= 0 || portNum > 65535 ||
+        (strcmp(mode, "plain") != 0 && !tls)) {
+      Serial.println("Usage: broker <host> <port> <plain|tls>");
+      return;
+    }
+#ifndef BROKER_TLS
+    if (tls) {
+      Serial.println("TLS not built in (build with -DBROKER_TLS)");
+      return;
+    }
+#endif
+    brokerPrefs.begin("broker", false);
+    brokerPrefs.putString("host", host);
+    brokerPrefs.putUShort("port", (uint16_t)portNum);
+    brokerPrefs.putBool("tls", tls);
+    brokerPrefs.end();
+    Serial.println("Broker saved, reboot to apply");
+  } else if (strcmp(cmd, "ca") == 0) {
+#ifndef BROKER_TLS
+    Serial.println("TLS not built in (build with -DBROKER_TLS)");
+    return;
+#endif
+    caInput = (char*)malloc(BROKER_CA_MAX_LEN);
+    if (caInput == NULL) return;
+    caInputLen = 0;
+    caInput[0] = '\0';
+    Serial.println("Paste CA certificate (PEM):");
+  } else if (strcmp(cmd, "reboot") == 0) {
+    ESP.restart();
+  } else {
+    Serial.println("Commands: broker, ca, reboot");
+  }
+}
+
+// Đọc Serial không block, xử lý từng dòng
+void serviceSerialConsole() {
+  while (Serial.available()) {
+    int c = Serial.read();
+    if (c == '\r' || c == '\n') {
+      if (consoleLen == 0) continue;
+      consoleLine[consoleLen] = '\0';
+      consoleLen = 0;
+      handleConsoleLine(consoleLine);
+    } else if (consoleLen < CONSOLE_LINE_MAX - 1) {
+      consoleLine[consoleLen++] = (char)c;
+    }
+  }
+}
+
 // ============================================
 // SETUP
 // ============================================
 void setup() {
   Serial.begin(115200);
   Serial.println("\n=== AI Smart Washer ===");
-  Serial.println("Machine ID: " + String(MACHINE_ID));
+  Serial.println("Machine ID: " MACHINE_ID);
   
   // GPIO Setup
   pinMode(PIN_RELAY_MOTOR, OUTPUT);
@@ -525,39 +1160,50 @@ void setup() {
   pinMode(PIN_BTN_PAUSE, INPUT_PULLUP);
   pinMode(PIN_DOOR_SWITCH, INPUT_PULLUP);
   
+  loadCounters();
   stopAllRelays();
   noTone(PIN_BUZZER);
   
+  // WiFi Setup - bắt đầu trước LCD để association chạy song song với LCD init
+  setupWifi();
+  
   // LCD Setup
   Wire.begin(21, 22);
   lcd.init();
   lcd.backlight();
+  bootLcdMs = millis();
   
-  // WiFi Setup
-  setupWifi();
-  
-  // MQTT Setup
-  mqtt.setServer(MQTT_SERVER, MQTT_PORT);
-  mqtt.setCallback(mqttCallback);
-  mqtt.setBufferSize(512);
+  // MQTT Setup - TCP/TLS connect chạy trong task nền trên core 0
+  loadBrokerConfig();
+  for (PubSubClient& session : mqttSessions) {
+    session.setServer(brokerConfig.host, brokerConfig.port);
+    session.setCallback(mqttCallback);
+    session.setBufferSize(512);
+    session.setSocketTimeout(MQTT_SOCKET_TIMEOUT_S);
+  }
+  xTaskCreatePinnedToCore(mqttConnectTask, "mqttConnect", MQTT_CONNECT_STACK, NULL, 1,
+                          &mqttConnectTaskHandle, 0);
   
   // Start in READY state
   powerOn();
+  bootReadyMs = millis();
+  Serial.printf("READY after %lums (lcd init done at %lums)\n", bootReadyMs, bootLcdMs);
 }
 
 // ============================================
 // MAIN LOOP
 // ============================================
 void loop() {
-  unsigned long currentMillis = millis();
+  uint32_t currentMillis = millis();
   
-  // Maintain MQTT connection
-  if (WiFi.status() == WL_CONNECTED) {
-    if (!mqtt.connected()) {
-      connectMqtt();
-    }
-    mqtt.loop();
-  }
+  // Maintain WiFi/MQTT connection (không block)
+  maintainNetwork();
+  serviceDisplayTimers();
+  serviceSerialConsole();
+  
+  // Bộ đếm bảo trì: ghi NVS khi rảnh, báo cáo qua heartbeat
+  maintainCounters();
+  publishHeartbeat();
   
   // Handle buttons
   handleStartButton();
@@ -571,6 +1217,7 @@ void loop() {
   
   // Publish status periodically
   publishStatus();
+  sampleTelemetry();
   
   // Read sensors
   int waterLvl = readWaterLevel();
@@ -582,31 +1229,33 @@ void loop() {
   switch (currentState) {
     
     case READY:
+      if (splashActive) break;
       lcd.setCursor(0, 0); lcd.print("=== READY ===       ");
       lcd.setCursor(0, 1); lcd.print("ID: "); lcd.print(MACHINE_ID); lcd.print("      ");
       lcd.setCursor(0, 2); lcd.print("Press START button  ");
       lcd.setCursor(0, 3); lcd.print("Door: ");
-      lcd.print(digitalRead(PIN_DOOR_SWITCH) == LOW ? "CLOSED" : "OPEN  ");
+      lcd.print(readDoorOpen() ? "OPEN  " : "CLOSED");
       break;
 
     case CHECK_SYSTEM:
       if (waterLvl > WATER_EMPTY_THRESHOLD) {
         lcd.setCursor(0, 0); lcd.print("! DRAINING OLD !    ");
         drawProgressBar(2, waterLvl, "Water:");
-        digitalWrite(PIN_RELAY_VALVE, HIGH);
+        writeRelay(PIN_RELAY_VALVE, HIGH);
       } else {
-        digitalWrite(PIN_RELAY_VALVE, LOW);
+        writeRelay(PIN_RELAY_VALVE, LOW);
         currentState = FILLING;
         phaseStartTime = currentMillis;
+        waterConfirmCount = 0;
         lcd.clear();
       }
       break;
 
     case FILLING:
       {
-        digitalWrite(PIN_RELAY_VALVE, HIGH);
+        writeRelay(PIN_RELAY_VALVE, HIGH);
         lcd.setCursor(0, 0); lcd.print("FILLING WATER...    ");
-        if (currentOrderCode.length() > 0) {
+        if (currentOrderCode[0] != '\0') {
           lcd.setCursor(0, 1); lcd.print("Order: "); lcd.print(currentOrderCode);
         }
         drawProgressBar(2, waterLvl, "Level:");
@@ -617,13 +1266,13 @@ void loop() {
         lcd.print((FILL_TIMEOUT_MS - elapsed) / 1000);
         lcd.print("s   ");
 
-        if (waterLvl >= WATER_FULL_THRESHOLD) {
-          digitalWrite(PIN_RELAY_VALVE, LOW);
+        if (waterLevelConfirmed(waterLvl >= WATER_FULL_THRESHOLD)) {
+          writeRelay(PIN_RELAY_VALVE, LOW);
           currentState = MIXING;
           phaseStartTime = currentMillis;
           lcd.clear();
         } else if (elapsed >= FILL_TIMEOUT_MS) {
-          digitalWrite(PIN_RELAY_VALVE, LOW);
+          writeRelay(PIN_RELAY_VALVE, LOW);
           currentState = ERROR_WATER;
           errorNotified = false;
           lcd.clear();
@@ -650,7 +1299,7 @@ void loop() {
 
     case MIXING:
       {
-        digitalWrite(PIN_RELAY_MOTOR, HIGH);
+        writeRelay(PIN_RELAY_MOTOR, HIGH);
         lcd.setCursor(0, 0); lcd.print("MIXING CLOTHES...   ");
         
         unsigned long elapsed = currentMillis - phaseStartTime;
@@ -658,7 +1307,7 @@ void loop() {
         drawProgressBar(2, progress, "Prog:");
         
         if (elapsed >= MIX_DURATION_MS) {
-          digitalWrite(PIN_RELAY_MOTOR, LOW);
+          writeRelay(PIN_RELAY_MOTOR, LOW);
           currentState = SENSING;
           sensingStartTime = currentMillis;
           sensingSampled = false;
@@ -704,7 +1353,7 @@ void loop() {
       {
         unsigned long elapsed = currentMillis - phaseStartTime;
         bool motorOn = ((elapsed / 2000) % 2 == 0);
-        digitalWrite(PIN_RELAY_MOTOR, motorOn ? HIGH : LOW);
+        writeRelay(PIN_RELAY_MOTOR, motorOn ? HIGH : LOW);
 
         lcd.setCursor(0, 0);
         lcd.print("WASHING: ");
@@ -724,7 +1373,7 @@ void loop() {
         lcd.print("s   ");
 
         if (elapsed >= washDuration) {
-          digitalWrite(PIN_RELAY_MOTOR, LOW);
+          writeRelay(PIN_RELAY_MOTOR, LOW);
           currentState = DRAINING;
           phaseStartTime = currentMillis;
           lcd.clear();
@@ -733,12 +1382,12 @@ void loop() {
       break;
 
     case DRAINING:
-      digitalWrite(PIN_RELAY_VALVE, HIGH);
+      writeRelay(PIN_RELAY_VALVE, HIGH);
       lcd.setCursor(0, 0); lcd.print("DRAINING...         ");
       drawProgressBar(2, waterLvl, "Level:");
       
-      if (waterLvl <= WATER_EMPTY_THRESHOLD) {
-        digitalWrite(PIN_RELAY_VALVE, LOW);
+      if (waterLevelConfirmed(waterLvl <= WATER_EMPTY_THRESHOLD)) {
+        writeRelay(PIN_RELAY_VALVE, LOW);
         currentState = SPINNING;
         phaseStartTime = currentMillis;
         lcd.clear();
@@ -747,7 +1396,7 @@ void loop() {
 
     case SPINNING:
       {
-        digitalWrite(PIN_RELAY_MOTOR, HIGH);
+        writeRelay(PIN_RELAY_MOTOR, HIGH);
         lcd.setCursor(0, 0); lcd.print("SPINNING...         ");
         
         unsigned long elapsed = currentMillis - phaseStartTime;
@@ -760,9 +1409,11 @@ void loop() {
         lcd.print("s   ");
         
         if (elapsed >= SPIN_DURATION_MS) {
-          digitalWrite(PIN_RELAY_MOTOR, LOW);
+          writeRelay(PIN_RELAY_MOTOR, LOW);
           currentState = DONE;
           phaseStartTime = currentMillis;
+          countCycleDone();
+          flushCounters();
           publishDone(); // Notify server - sẽ gửi email cho khách
           beep(1000, 200);
           lcd.clear();
@@ -774,7 +1425,7 @@ void loop() {
       stopAllRelays();
       lcd.setCursor(0, 0); lcd.print("=== PAUSED ===      ");
       lcd.setCursor(0, 1); lcd.print("Order: "); 
-      lcd.print(currentOrderCode.length() > 0 ? currentOrderCode : "N/A");
+      lcd.print(currentOrderCode[0] != '\0' ? currentOrderCode : "N/A");
       lcd.setCursor(0, 2); lcd.print("YELLOW: Resume      ");
       lcd.setCursor(0, 3); lcd.print("GREEN: Power Off    ");
       break;
@@ -801,7 +1452,7 @@ void loop() {
         stopAllRelays();
         lcd.setCursor(0, 0); lcd.print("=== COMPLETED ===   ");
         lcd.setCursor(0, 1); lcd.print("Order: "); 
-        lcd.print(currentOrderCode.length() > 0 ? currentOrderCode : "N/A");
+        lcd.print(currentOrderCode[0] != '\0' ? currentOrderCode : "N/A");
         lcd.setCursor(0, 2); lcd.print("Please collect!     ");
         
         unsigned long elapsed = currentMillis - phaseStartTime;
@@ -816,9 +1467,8 @@ void loop() {
         }
         
         if (elapsed >= DONE_AUTO_OFF_MS) {
-          currentOrderCode = "";
+          currentOrderCode[0] = '\0';
           powerOff();
-          delay(500);
           powerOn();
         }
       }
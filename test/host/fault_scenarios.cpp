@@ -0,0 +1,729 @@
+// ============================================
+// FAULT SCENARIOS (chạy trên host, không flash)
+//   fault-scenarios [-v]        hoặc   ctest --test-dir build
+// Chạy src/main.cpp nguyên bản trên stub ở stubs/: đồng hồ, cửa, bồn nước và
+// broker đều giả (xem stubs/sim_board.h), lệnh đi qua broker như từ server.
+// Mỗi kịch bản in 1 dòng FAULT_REPORT:
+//   lost        - event lỗi bị bỏ (droppedEvents) + chu trình không có DONE event
+//   violations  - số lần relay còn bật sau 1 vòng loop mà cửa đang mở
+//   spurious    - chuyển trạng thái / thay đổi mà kịch bản không chờ đợi
+//   recoverMs   - (MQTT_DROP, DOOR_BOUNCE) từ lúc hết lỗi tới khi hoạt động lại
+//   parseMaxUs  - (BAD_PAYLOAD) callback lâu nhất, đo bằng đồng hồ host
+//   doorTrips   - (DOOR_BOUNCE) số lần vào ERROR_DOOR / số lần chờ đợi
+//   driftMs     - (ROLLOVER) lệch thời lượng WASHING qua lần tràn millis()
+//   loopMaxMs   - (SLOW_CONNACK) 1 lần loop() lâu nhất trong lúc kết nối lại
+//   frames      - số frame telemetry giải được; mỗi mẫu được so với vòng loop()
+//                 đã lấy nó (flags, nước, độ bẩn, lưới thời gian)
+//   seqGaps     - số frame telemetry bị bỏ lúc mất MQTT (seq nhảy)
+//   badTelemetry- frame hỏng, mẫu sai giá trị/sai lưới, seq nhảy khi không mất MQTT
+//   regridMs    - (LOOP_STALL) mẫu đầu tiên sau lúc loop() đứng cách vòng đầu tiên bao xa
+//   nvsRelayOn  - số lần ghi NVS khi relay đang bật (in khi > 0 hoặc ở FORCE_FLUSH)
+//   flushIn     - (FORCE_FLUSH) trạng thái lúc bộ đếm quá hạn được ghi
+// Exit 1 nếu có lost/violations/spurious/badTelemetry/nvsRelayOn, thiếu door trip, drift
+// quá 1 vòng loop, loop() đứng quá 1 vòng lúc chờ CONNACK, mất MQTT mà seq không
+// nhảy, lưới telemetry không bắt đầu lại sau khi loop() đứng hoặc 1 chu trình
+// giặt không xong trong CYCLE_TIMEOUT_MS.
+// ============================================
+#include <Arduino.h>
+#include <PubSubClient.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "laundry_protocol.h"
+#include "machine_config.h"
+#include "sim_board.h"
+#include "telemetry_frame.h"
+
+// src/main.cpp
+extern State currentState;
+extern unsigned long droppedEvents;
+extern unsigned long washDuration;
+extern char currentOrderCode[];
+extern PubSubClient* mqtt;
+extern uint32_t lastCounterFlush;
+extern uint32_t counterSeq;
+void setup();
+void loop();
+
+#define CYCLE_TIMEOUT_MS        90000   // START tới DONE event, kể cả lúc mất broker
+#define BROKER_OUTAGE_MS        15000   // Dài hơn DONE_AUTO_OFF_MS: DONE phải chờ broker
+#define SPIKE_PERCENT           5
+#define SPIKE_WINDOW_MS         3000
+#define DOOR_BOUNCE_LOOPS       6
+#define DOOR_TRIPS_EXPECTED     1       // Lần mở đầu tiên; các lần rung sau nằm trong ERROR_DOOR
+#define ROLLOVER_LEAD_MS        15000   // millis() tràn ~15s sau START, giữa WASHING
+#define DIRT_ADC_NORMAL         1000
+#define CONNACK_DELAY_MS        1500    // Dưới MQTT_SOCKET_TIMEOUT_S: kết nối vẫn thành công
+#define LOOP_STALL_MS           730     // Lệch lưới TELEMETRY_SAMPLE_MS
+#define ADC_MAX                 4095
+
+static const char TOPIC_COMMAND[] = LAUNDRY_TOPIC_COMMAND(MACHINE_ID);
+static const char TOPIC_EVENTS[] = LAUNDRY_TOPIC_EVENTS;
+static const char TOPIC_TELEMETRY[] = LAUNDRY_TOPIC_TELEMETRY(MACHINE_ID);
+
+// ADC độ bẩn đổi mỗi 100ms theo bảng: delta âm/dương, varint 1 và 2 byte,
+// luôn dưới DIRT_HEAVY_THRESHOLD để chế độ giặt không đổi
+static const int dirtWave[] = {
+  DIRT_ADC_NORMAL, DIRT_ADC_NORMAL + 5, DIRT_ADC_NORMAL + 2, DIRT_ADC_NORMAL + 66,
+  DIRT_ADC_NORMAL + 2, DIRT_ADC_NORMAL + 65, DIRT_ADC_NORMAL, DIRT_ADC_NORMAL + 200,
+  300, 2900,
+};
+
+struct Report {
+  const char* name;
+  unsigned long lost;
+  unsigned long violations;
+  unsigned long maxViolationMs;
+  unsigned long spurious;
+  long recoverMs;               // -1 = không áp dụng cho kịch bản này
+  long parseMaxUs;
+  long doorTrips;
+  long driftMs;
+  long loopMaxMs;
+  long frames;
+  unsigned long seqGaps;
+  unsigned long badTelemetry;
+  long regridMs;
+  unsigned long nvsRelayOn;
+  State wrapState;
+  State flushState;             // FORCE_FLUSH: trạng thái lúc ghi NVS đầu tiên              // ROLLOVER: trạng thái lúc millis() tràn
+  bool timedOut;
+};
+
+// Trạng thái của kịch bản đang chạy
+struct Run {
+  Report report;
+  unsigned long deadline;
+  unsigned long droppedAtStart;
+  unsigned long expectedDrops;  // Event lỗi lúc mất broker: firmware bỏ và đếm, đúng thiết kế
+  unsigned long violationStart;
+  bool inViolation;
+  State lastState;
+  unsigned long lastMillis;
+  unsigned long washStart;
+  unsigned long washMs;
+  unsigned long loopMaxMs;
+  size_t publishedFrom;         // simPublished() trước kịch bản này
+  unsigned long truthFrom;
+  bool seqGapsExpected;
+  unsigned long stallEnd;       // LOOP_STALL: simRawMillis() lúc loop() chạy lại
+  char orders[4][LAUNDRY_ORDER_CODE_MAX_LEN + 1];
+  uint8_t orderCount;
+};
+
+static Run run;
+static int failedScenarios = 0;
+
+// Máy trong 1 vòng loop() (khoá: simRawMillis() lúc bắt đầu), đáp án cho mẫu
+// telemetry lấy trong vòng đó
+struct LoopTruth {
+  uint32_t millisAt;            // millis() của firmware lúc bắt đầu
+  // Firmware lấy mẫu giữa vòng (sau lệnh/cửa, trước state machine: có thể là
+  // state trung gian) và dựng flags ngay sau lần đọc ADC độ bẩn đầu tiên
+  uint8_t flags;
+  bool flagsCaptured;
+  int water;                    // ADC kịch bản đặt trước vòng, đổi sang 0-100 như firmware
+  int dirt;
+  bool exactWater;              // False khi đang có spike ADC
+  bool linkDown;                // Phiên MQTT đứt trước hoặc sau vòng
+  bool sampled;
+};
+
+static std::map<unsigned long, LoopTruth> loopTruth;
+static LoopTruth* loopInProgress = NULL;
+
+// mqttConnectTask vẫn chạy trên thread riêng: thoát luôn, không chạy
+// destructor của biến toàn cục trong firmware
+static void finish(int code) {
+  fflush(stdout);
+  _Exit(code);
+}
+
+// Bồn nước: cùng 1 van cho cấp và xả (FILLING cấp, CHECK_SYSTEM/DRAINING xả)
+static int waterLevel = 0;
+static int waterAdc = 0;
+static int waterSpikePercent = 0;
+static int dirtAdc = DIRT_ADC_NORMAL;
+static unsigned long lastPlantUpdate = 0;
+static bool doorOpen = false;
+
+static void setDoor(bool open) {
+  doorOpen = open;
+  simSetInput(PIN_DOOR_SWITCH, open ? HIGH : LOW);
+}
+
+static void setWaterSpikes(int percent) {
+  waterSpikePercent = percent;
+  simSetAnalogSpikes(PIN_POT_WATER, percent);
+}
+
+static void updatePlant() {
+  unsigned long steps = (simRawMillis() - lastPlantUpdate) / 100;
+  if (steps == 0) return;
+  lastPlantUpdate += steps * 100;
+
+  if (simPinLevel(PIN_RELAY_VALVE) == HIGH) {
+    if (currentState == FILLING) {
+      waterLevel = min(100, waterLevel + 2 * (int)steps);
+    } else if (currentState == CHECK_SYSTEM || currentState == DRAINING) {
+      waterLevel = max(0, waterLevel - 3 * (int)steps);
+    }
+  }
+  waterAdc = map(waterLevel, 0, 100, 0, ADC_MAX);
+  simSetAnalog(PIN_POT_WATER, waterAdc);
+  dirtAdc = dirtWave[(lastPlantUpdate / 100) % (sizeof(dirtWave) / sizeof(dirtWave[0]))];
+  simSetAnalog(PIN_POT_DIRT, dirtAdc);
+}
+
+static uint8_t machineFlags() {
+  return (simPinLevel(PIN_RELAY_MOTOR) == HIGH ? TELEMETRY_FLAG_MOTOR : 0) |
+         (simPinLevel(PIN_RELAY_VALVE) == HIGH ? TELEMETRY_FLAG_VALVE : 0) |
+         (doorOpen ? TELEMETRY_FLAG_DOOR : 0) |
+         (currentState << TELEMETRY_STATE_SHIFT);
+}
+
+static bool relayOn() {
+  return simPinLevel(PIN_RELAY_MOTOR) == HIGH || simPinLevel(PIN_RELAY_VALVE) == HIGH;
+}
+
+// Ghi NVS làm loop() đứng: không được xảy ra khi motor/van đang chạy
+static void onFlashWrite() {
+  if (relayOn()) run.report.nvsRelayOn++;
+  if (run.report.flushState == STATE_COUNT) run.report.flushState = currentState;
+}
+
+static void onAnalogRead(uint8_t pin) {
+  if (pin != PIN_POT_DIRT || loopInProgress == NULL || loopInProgress->flagsCaptured) return;
+  loopInProgress->flags = machineFlags();
+  loopInProgress->flagsCaptured = true;
+}
+
+// Firmware có đúng 1 vòng loop để ngắt relay sau khi cửa mở
+static void checkSafety() {
+  if (relayOn() && doorOpen) {
+    if (!run.inViolation) {
+      run.report.violations++;
+      run.violationStart = simRawMillis() - LOOP_DELAY_MS;   // Relay đã bật suốt vòng vừa chạy
+      run.inViolation = true;
+    }
+    run.report.maxViolationMs = max(run.report.maxViolationMs, simRawMillis() - run.violationStart);
+  } else {
+    run.inViolation = false;
+  }
+}
+
+static void trackState() {
+  unsigned long now = simRawMillis();
+  if (currentState != run.lastState) {
+    if (currentState == ERROR_DOOR && run.report.doorTrips >= 0) run.report.doorTrips++;
+    if (currentState == WASHING) run.washStart = now;
+    if (run.lastState == WASHING) run.washMs = now - run.washStart;
+    run.lastState = currentState;
+  }
+
+  unsigned long m = millis();
+  if (m < run.lastMillis) run.report.wrapState = currentState;
+  run.lastMillis = m;
+}
+
+// 1 vòng loop() của firmware (loop tự delay LOOP_DELAY_MS) + phần mô phỏng.
+// False khi hết giờ.
+static bool step() {
+  if ((long)(simRawMillis() - run.deadline) >= 0) {
+    run.report.timedOut = true;
+    return false;
+  }
+  unsigned long before = simRawMillis();
+  LoopTruth truth;
+  truth.millisAt = millis();
+  truth.flags = 0;
+  truth.flagsCaptured = false;
+  truth.water = map(waterAdc, 0, ADC_MAX, 0, 100);
+  truth.dirt = dirtAdc;
+  truth.exactWater = waterSpikePercent == 0;
+  truth.linkDown = !mqtt->connected();
+  truth.sampled = false;
+  loopInProgress = &truth;
+  loop();
+  loopInProgress = NULL;
+  run.loopMaxMs = max(run.loopMaxMs, simRawMillis() - before);
+  truth.linkDown = truth.linkDown || !mqtt->connected();
+  loopTruth[before] = truth;
+  updatePlant();
+  checkSafety();
+  trackState();
+  return true;
+}
+
+template <typename Pred>
+static bool runUntil(Pred done) {
+  while (!done()) {
+    if (!step()) return false;
+  }
+  return true;
+}
+
+static bool runFor(unsigned long ms) {
+  unsigned long end = simRawMillis() + ms;
+  return runUntil([end] { return simRawMillis() >= end; });
+}
+
+static bool mqttUp() {
+  return simSubscribed(TOPIC_COMMAND);
+}
+
+// Lệnh từ server: xử lý trong mqtt.loop() của vòng kế tiếp
+static bool sendCommand(const char* json, size_t len) {
+  if (!runUntil(mqttUp)) return false;
+  simDeliver(TOPIC_COMMAND, json, len);
+  return step();
+}
+
+static bool sendCommand(const char* json) {
+  return sendCommand(json, strlen(json));
+}
+
+static bool ensureReady() {
+  if (currentState != READY && !sendCommand("{\"command\":\"RESET\"}")) return false;
+  return runUntil([] { return currentState == READY && mqttUp(); });
+}
+
+static bool startCycle(const char* orderCode) {
+  if (!ensureReady()) return false;
+  run.deadline = simRawMillis() + CYCLE_TIMEOUT_MS;
+  if (run.orderCount < sizeof(run.orders) / sizeof(run.orders[0])) {
+    strlcpy(run.orders[run.orderCount++], orderCode, sizeof(run.orders[0]));
+  }
+  char json[64];
+  snprintf(json, sizeof(json), "{\"command\":\"START\",\"orderCode\":\"%s\"}", orderCode);
+  return sendCommand(json);
+}
+
+static unsigned long doneEvents(const char* orderCode) {
+  char order[32];
+  snprintf(order, sizeof(order), "\"orderCode\":\"%s\"", orderCode);
+  unsigned long n = 0;
+  const std::vector<SimMessage>& published = simPublished();
+  for (size_t i = 0; i < published.size(); i++) {
+    const SimMessage& msg = published[i];
+    if (msg.topic == TOPIC_EVENTS && msg.payload.find("\"event\":\"DONE\"") != std::string::npos &&
+        msg.payload.find(order) != std::string::npos) {
+      n++;
+    }
+  }
+  return n;
+}
+
+// Chu trình xong khi server nhận được DONE event (email cho khách dựa vào nó)
+static bool finishCycle(const char* orderCode) {
+  return runUntil([orderCode] { return doneEvents(orderCode) > 0; });
+}
+
+static void beginScenario(const char* name) {
+  memset(&run, 0, sizeof(run));
+  run.report.name = name;
+  run.report.recoverMs = -1;
+  run.report.parseMaxUs = -1;
+  run.report.doorTrips = -1;
+  run.report.driftMs = -1;
+  run.report.loopMaxMs = -1;
+  run.report.regridMs = -1;
+  run.report.wrapState = (State)STATE_COUNT;
+  run.report.flushState = (State)STATE_COUNT;
+  run.deadline = simRawMillis() + CYCLE_TIMEOUT_MS;
+  run.droppedAtStart = droppedEvents;
+  run.lastState = currentState;
+  run.lastMillis = millis();
+  run.publishedFrom = simPublished().size();
+  run.truthFrom = simRawMillis();
+  loopTruth.clear();
+  setDoor(false);
+  setWaterSpikes(0);
+  simSetBrokerUp(true);
+  simSetConnackDelay(0);
+}
+
+static bool linkDownBetween(unsigned long from, unsigned long to) {
+  std::map<unsigned long, LoopTruth>::const_iterator it = loopTruth.lower_bound(from);
+  for (; it != loopTruth.end() && it->first <= to; ++it) {
+    if (it->second.linkDown) return true;
+  }
+  return false;
+}
+
+static void telemetryError(const TelemetryFrame& frame, const char* what) {
+  printf("  telemetry seq %u: %s\n", (unsigned)frame.seq, what);
+  run.report.badTelemetry++;
+}
+
+// Giải mọi frame telemetry gửi trong kịch bản như server, mỗi mẫu phải là của
+// đúng 1 vòng loop() bắt đầu trong [t, t + TELEMETRY_SAMPLE_MS), khớp máy lúc
+// đó và cách mẫu trước ít nhất TELEMETRY_SAMPLE_MS
+static void checkTelemetry() {
+  Report& r = run.report;
+  const std::vector<SimMessage>& published = simPublished();
+  TelemetryFrame prev;
+  unsigned long prevAt = 0;
+  bool havePrev = false;
+  long long lastSample = -1;
+  bool afterStall = false;
+  unsigned long firstAfterStall = 0;
+  r.frames = 0;
+
+  for (size_t i = run.publishedFrom; i < published.size(); i++) {
+    const SimMessage& msg = published[i];
+    if (msg.topic != TOPIC_TELEMETRY) continue;
+    TelemetryFrame frame;
+    std::string error;
+    if (!decodeTelemetryFrame(msg.payload, &frame, &error)) {
+      printf("  telemetry frame %u: %s\n", (unsigned)i, error.c_str());
+      r.badTelemetry++;
+      continue;
+    }
+    r.frames++;
+    if (frame.sampleMs != TELEMETRY_SAMPLE_MS) telemetryError(frame, "sample period");
+
+    // seq tăng cả khi frame bị bỏ: nhảy seq chỉ hợp lệ nếu MQTT đứt ở giữa
+    if (havePrev) {
+      uint16_t d = frame.seq - prev.seq;
+      if (d == 0 || d >= 0x8000) {
+        telemetryError(frame, "seq repeated or went back");
+      } else if (d > 1) {
+        r.seqGaps += d - 1;
+        if (!linkDownBetween(prevAt, msg.at)) telemetryError(frame, "seq gap without MQTT outage");
+      }
+    }
+    prev = frame;
+    prevAt = msg.at;
+    havePrev = true;
+
+    // Vòng loop() đã publish frame: quy millis() của mẫu về simRawMillis()
+    std::map<unsigned long, LoopTruth>::iterator pub = loopTruth.upper_bound(msg.at);
+    if (pub == loopTruth.begin()) continue;
+    --pub;
+
+    for (size_t k = 0; k < frame.samples.size(); k++) {
+      const TelemetrySample& s = frame.samples[k];
+      int32_t age = (int32_t)(pub->second.millisAt - s.t);
+      if (age < 0) {
+        telemetryError(frame, "sample timestamp after publish");
+        continue;
+      }
+      long long raw = (long long)pub->first - age;
+      if (raw < (long long)run.truthFrom) continue;   // Lấy trước kịch bản này
+
+      std::map<unsigned long, LoopTruth>::iterator it = loopTruth.lower_bound((unsigned long)raw);
+      if (it == loopTruth.end() || it->first > msg.at) {
+        telemetryError(frame, "sample taken by no loop");
+        continue;
+      }
+      LoopTruth& truth = it->second;
+      if (it->first - raw >= TELEMETRY_SAMPLE_MS) {
+        telemetryError(frame, "sample off the time grid");
+      } else if (lastSample >= 0 && raw - lastSample < TELEMETRY_SAMPLE_MS) {
+        telemetryError(frame, "samples closer than TELEMETRY_SAMPLE_MS");
+      } else if (truth.sampled) {
+        telemetryError(frame, "two samples in one loop");
+      } else if (!truth.flagsCaptured || s.flags != truth.flags) {
+        telemetryError(frame, "flags (relay/door/state)");
+      } else if (truth.exactWater && s.water != truth.water) {
+        telemetryError(frame, "water level");
+      } else if (s.dirt != truth.dirt) {
+        telemetryError(frame, "dirt level");
+      }
+      truth.sampled = true;
+      lastSample = raw;
+
+      if (run.stallEnd > 0 && raw >= (long long)run.stallEnd &&
+          (!afterStall || (unsigned long)raw < firstAfterStall)) {
+        firstAfterStall = (unsigned long)raw;
+        afterStall = true;
+      }
+    }
+  }
+
+  if (run.stallEnd > 0) {
+    if (afterStall) r.regridMs = firstAfterStall - run.stallEnd;
+    else r.badTelemetry++;
+  }
+}
+
+static void endScenario() {
+  Report& r = run.report;
+  checkTelemetry();
+  r.lost += droppedEvents - run.droppedAtStart - run.expectedDrops;
+  for (uint8_t i = 0; i < run.orderCount; i++) {
+    unsigned long n = doneEvents(run.orders[i]);
+    if (n == 0) r.lost++;
+    else r.spurious += n - 1;   // DONE gửi lặp
+  }
+
+  printf("FAULT_REPORT %s lost=%lu violations=%lu maxViolationMs=%lu spurious=%lu",
+         r.name, r.lost, r.violations, r.maxViolationMs, r.spurious);
+  if (r.recoverMs >= 0) printf(" recoverMs=%ld", r.recoverMs);
+  if (r.parseMaxUs >= 0) printf(" parseMaxUs=%ld", r.parseMaxUs);
+  if (r.doorTrips >= 0) printf(" doorTrips=%ld/%d", r.doorTrips, DOOR_TRIPS_EXPECTED);
+  if (r.loopMaxMs >= 0) printf(" loopMaxMs=%ld", r.loopMaxMs);
+  printf(" frames=%ld seqGaps=%lu badTelemetry=%lu", r.frames, r.seqGaps, r.badTelemetry);
+  if (r.regridMs >= 0) printf(" regridMs=%ld", r.regridMs);
+  if (r.nvsRelayOn > 0 || strcmp(r.name, "FORCE_FLUSH") == 0) {
+    printf(" nvsRelayOn=%lu flushIn=%s", r.nvsRelayOn,
+           r.flushState < STATE_COUNT ? stateNames[r.flushState] : "none");
+  }
+  if (r.driftMs >= 0) {
+    printf(" driftMs=%ld wrapIn=%s", r.driftMs,
+           r.wrapState < STATE_COUNT ? stateNames[r.wrapState] : "none");
+  }
+  printf("%s\n", r.timedOut ? " TIMEOUT" : "");
+
+  bool ok = r.lost == 0 && r.violations == 0 && r.spurious == 0 && r.badTelemetry == 0 &&
+            r.nvsRelayOn == 0 && !r.timedOut;
+  if (r.doorTrips >= 0 && r.doorTrips < DOOR_TRIPS_EXPECTED) ok = false;   // Cửa mở mà không báo lỗi
+  if (r.driftMs >= 0 && (r.driftMs > LOOP_DELAY_MS || r.wrapState != WASHING)) ok = false;
+  if (r.loopMaxMs > LOOP_DELAY_MS) ok = false;   // loop() chỉ được delay(LOOP_DELAY_MS)
+  if (run.seqGapsExpected && r.seqGaps == 0) ok = false;   // Frame lúc mất MQTT không tốn seq
+  if (r.regridMs > 0) ok = false;   // Mẫu đầu sau khi đứng phải ở ngay vòng đầu tiên
+  if (!ok) failedScenarios++;
+}
+
+// Mất broker ở từng pha giặt; broker quay lại sau BROKER_OUTAGE_MS
+static void scenarioMqttDrop() {
+  static const State phases[] = { FILLING, WASHING, DRAINING, SPINNING };
+  beginScenario("MQTT_DROP");
+  run.seqGapsExpected = true;   // BROKER_OUTAGE_MS dài hơn TELEMETRY_FRAME_MS
+  for (size_t i = 0; i < sizeof(phases) / sizeof(phases[0]); i++) {
+    char order[LAUNDRY_ORDER_CODE_MAX_LEN + 1];
+    snprintf(order, sizeof(order), "DROP%u", (unsigned)i);
+    State phase = phases[i];
+    if (!startCycle(order) || !runUntil([phase] { return currentState == phase; })) break;
+
+    simSetBrokerUp(false);
+    simDropConnections();
+    if (!runFor(BROKER_OUTAGE_MS)) break;
+    simSetBrokerUp(true);
+    unsigned long upAt = simRawMillis();
+    if (!runUntil(mqttUp)) break;
+    run.report.recoverMs = max(run.report.recoverMs, (long)(simRawMillis() - upAt));
+    if (!finishCycle(order)) break;
+  }
+  endScenario();
+}
+
+// Payload hỏng/sai kiểu/quá cỡ khi đang giặt: không được đổi trạng thái hay mã đơn
+static void scenarioBadPayload() {
+  static const char* const payloads[] = {
+    "", "not json", "{}", "[]", "null",
+    "{\"command\":null}", "{\"command\":5}", "{\"command\":[\"PAUSE\"]}",
+    "{\"command\":{\"PAUSE\":1}}", "{\"command\":\"\"}", "{\"command\":\"BOGUS\"}",
+    "{\"command\":\"PAU", "{\"command\":\"PAUSE\",}",
+    "{\"command\":\"START\",\"orderCode\":\"ZZZZZZ\"}",
+    "[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]",
+  };
+
+  beginScenario("BAD_PAYLOAD");
+  if (!startCycle("BAD1") || !runUntil([] { return currentState == WASHING; })) {
+    endScenario();
+    return;
+  }
+
+  // PAUSE hợp lệ nhưng quá MQTT_COMMAND_MAX_LEN: phải bị bỏ trước khi parse
+  std::string oversized = "{\"command\":\"PAUSE\",\"x\":\"";
+  oversized.append(MQTT_COMMAND_MAX_LEN * 2 - oversized.size() - 2, 'A');
+  oversized += "\"}";
+
+  std::vector<std::string> all(payloads, payloads + sizeof(payloads) / sizeof(payloads[0]));
+  all.push_back(oversized);
+
+  run.report.parseMaxUs = 0;
+  for (size_t i = 0; i < all.size(); i++) {
+    if (!sendCommand(all[i].data(), all[i].size())) break;
+    run.report.parseMaxUs = max(run.report.parseMaxUs, (long)simDispatchMaxUs());
+    if (currentState != WASHING || strcmp(currentOrderCode, "BAD1") != 0) {
+      printf("  unexpected change after payload %u\n", (unsigned)i);
+      run.report.spurious++;
+    }
+  }
+  finishCycle("BAD1");
+  endScenario();
+}
+
+// 5% lần đọc ADC mực nước kẹt 4095 trong lúc cấp nước
+static void scenarioAdcSpike() {
+  beginScenario("ADC_SPIKE");
+  if (startCycle("ADC1") && runUntil([] { return currentState == FILLING; })) {
+    setWaterSpikes(SPIKE_PERCENT);
+    unsigned long end = simRawMillis() + SPIKE_WINDOW_MS;
+    runUntil([end] { return simRawMillis() >= end || currentState != FILLING; });
+    if (currentState != FILLING && waterLevel < WATER_FULL_THRESHOLD) run.report.spurious++;
+    setWaterSpikes(0);
+    finishCycle("ADC1");
+  }
+  endScenario();
+}
+
+// Tiếp điểm cửa rung DOOR_BOUNCE_LOOPS vòng khi đang vắt, sau đó đóng hẳn.
+// Server gửi RESUME ngay khi thấy PAUSED (admin bấm tiếp tục sớm nhất có thể).
+static void scenarioDoorBounce() {
+  beginScenario("DOOR_BOUNCE");
+  run.report.doorTrips = 0;
+  if (startCycle("DOOR1") && runUntil([] { return currentState == SPINNING; })) {
+    int loops = 0;
+    unsigned long closedAt = 0;
+    bool resumeSent = false;
+    bool recovered = runUntil([&] {
+      if (loops < DOOR_BOUNCE_LOOPS) {
+        setDoor(loops % 2 == 0);
+        if (++loops == DOOR_BOUNCE_LOOPS) setDoor(false);
+        closedAt = simRawMillis();
+      }
+      if (currentState != PAUSED) {
+        resumeSent = false;
+      } else if (!resumeSent) {
+        static const char resume[] = "{\"command\":\"RESUME\"}";
+        simDeliver(TOPIC_COMMAND, resume, sizeof(resume) - 1);
+        resumeSent = true;
+      }
+      return loops == DOOR_BOUNCE_LOOPS && currentState == SPINNING &&
+             simPinLevel(PIN_RELAY_MOTOR) == HIGH;
+    });
+
+    if (recovered) {
+      run.report.recoverMs = simRawMillis() - closedAt;
+      finishCycle("DOOR1");
+    }
+    if (run.report.doorTrips > DOOR_TRIPS_EXPECTED) {
+      run.report.spurious += run.report.doorTrips - DOOR_TRIPS_EXPECTED;
+    }
+  }
+  endScenario();
+}
+
+// Mất broker khi đang giặt, broker mới trả CONNACK chậm CONNACK_DELAY_MS. Khách
+// mở cửa đúng lúc firmware đang chờ CONNACK: loop() phải vẫn chạy và ngắt relay.
+static void scenarioSlowConnack() {
+  beginScenario("SLOW_CONNACK");
+  run.report.doorTrips = 0;
+  if (startCycle("CONN1") && runUntil([] { return currentState == WASHING; })) {
+    simSetConnackDelay(CONNACK_DELAY_MS);
+    simDropConnections();
+    run.loopMaxMs = 0;
+
+    // Chờ tới khi connect() đang đứng chờ CONNACK (thấy được giữa 2 vòng loop
+    // chỉ khi connect() không chạy trong loop)
+    if (runUntil([] { return !mqttUp(); }) &&
+        runUntil([] { return simConnackPending() || mqttUp(); }) && simConnackPending()) {
+      setDoor(true);
+      step();
+      step();
+      setDoor(false);
+      run.expectedDrops = 1;   // DOOR_OPEN khi chưa có MQTT
+    }
+    bool resumeSent = false;
+    bool recovered = runUntil([&resumeSent] {
+      if (currentState == PAUSED && mqttUp() && !resumeSent) {
+        static const char resume[] = "{\"command\":\"RESUME\"}";
+        simDeliver(TOPIC_COMMAND, resume, sizeof(resume) - 1);
+        resumeSent = true;
+      }
+      return mqttUp() && currentState == WASHING;
+    });
+    run.report.loopMaxMs = run.loopMaxMs;
+    if (recovered) finishCycle("CONN1");
+  }
+  endScenario();
+}
+
+// loop() đứng LOOP_STALL_MS giữa lúc giặt (vd. bus I2C của LCD treo). Frame
+// telemetry đang dở phải đóng lại, lưới lấy mẫu bắt đầu lại từ vòng đầu tiên
+// sau đó thay vì đẻ mẫu cho khoảng thời gian loop() không chạy.
+static void scenarioLoopStall() {
+  beginScenario("LOOP_STALL");
+  if (startCycle("STALL1") && runUntil([] { return currentState == WASHING; }) &&
+      runFor(TELEMETRY_FRAME_MS / 2)) {
+    delay(LOOP_STALL_MS);
+    run.stallEnd = simRawMillis();
+    finishCycle("STALL1");
+  }
+  endScenario();
+}
+
+// Máy chạy liên tục đã quá COUNTER_FORCE_FLUSH_MS từ lần ghi bộ đếm cuối (lùi
+// mốc lastCounterFlush thay vì chạy 1 giờ) đúng lúc motor đang quay: bộ đếm phải
+// chờ tới vòng đầu tiên cả 2 relay tắt mới được ghi.
+static void scenarioForceFlush() {
+  beginScenario("FORCE_FLUSH");
+  if (startCycle("FLUSH1") &&
+      runUntil([] { return currentState == WASHING && simPinLevel(PIN_RELAY_MOTOR) == HIGH; })) {
+    uint32_t seq = counterSeq;
+    run.report.flushState = (State)STATE_COUNT;
+    lastCounterFlush = millis() - COUNTER_FORCE_FLUSH_MS;
+    if (runUntil([seq] { return counterSeq != seq; })) finishCycle("FLUSH1");
+  }
+  endScenario();
+}
+
+// Chỉnh đồng hồ tới millis() = target theo 2 bước tiến, mỗi bước < 2^31 ms:
+// phép so sánh có dấu trong firmware cũng thấy thời gian đi tới như máy thật
+static void advanceClockTo(uint32_t target) {
+  uint32_t now = millis();
+  uint32_t half = (uint32_t)(target - now) / 2;
+  simSetClockOffset((uint32_t)(now + half - (uint32_t)simRawMillis()));
+  step();
+  simSetClockOffset((uint32_t)(target - (uint32_t)simRawMillis()));
+}
+
+// millis() 32 bit như ESP32: đẩy tới sát 2^32 (~49 ngày) để lần tràn rơi vào
+// giữa WASHING. Biến thời gian nào trong firmware còn rộng hơn 32 bit sẽ thấy
+// hiệu số khổng lồ lúc tràn.
+static void scenarioRollover() {
+  beginScenario("ROLLOVER");
+  if (ensureReady()) {
+    advanceClockTo(0u - ROLLOVER_LEAD_MS);
+    run.lastMillis = millis();
+    if (startCycle("ROLL1")) {
+      unsigned long expectedMs = 0;
+      runUntil([&expectedMs] {
+        if (currentState == WASHING) expectedMs = washDuration;
+        return run.washMs > 0;
+      });
+      if (run.washMs > 0) {
+        run.report.driftMs = labs((long)run.washMs - (long)expectedMs);
+      }
+      finishCycle("ROLL1");
+    }
+  }
+  endScenario();
+}
+
+int main(int argc, char** argv) {
+  simSetVerbose(argc > 1 && strcmp(argv[1], "-v") == 0);
+  setDoor(false);
+  simSetAnalog(PIN_POT_DIRT, dirtAdc);
+  simSetAnalogReadHook(onAnalogRead);
+  simSetFlashWriteHook(onFlashWrite);
+
+  setup();
+  beginScenario("BOOT");
+  if (!runUntil([] { return currentState == READY && mqttUp(); })) {
+    printf("firmware never reached READY with MQTT connected\n");
+    finish(1);
+  }
+
+  scenarioMqttDrop();
+  scenarioBadPayload();
+  scenarioAdcSpike();
+  scenarioDoorBounce();
+  scenarioSlowConnack();
+  scenarioLoopStall();
+  scenarioForceFlush();
+  scenarioRollover();
+
+  if (failedScenarios > 0) {
+    printf("%d scenario(s) failed\n", failedScenarios);
+    finish(1);
+  }
+  printf("fault-scenarios: all scenarios passed\n");
+  finish(0);
+}
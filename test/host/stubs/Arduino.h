@@ -0,0 +1,125 @@
+// ============================================
+// ARDUINO (stub host) - đủ API cho src/main.cpp, xem sim_board.h
+// ============================================
+#ifndef ARDUINO_STUB_H
+#define ARDUINO_STUB_H
+
+#include <math.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+typedef uint8_t byte;
+
+#define HIGH          1
+#define LOW           0
+#define INPUT         0
+#define OUTPUT        1
+#define INPUT_PULLUP  2
+#define DEC           10
+#define HEX           16
+
+using std::max;
+using std::min;
+
+#define constrain(x, low, high)  ((x) < (low) ? (low) : ((x) > (high) ? (high) : (x)))
+
+struct IPAddress {
+  uint8_t octets[4];
+};
+
+class Print {
+ public:
+  virtual ~Print() {}
+
+  size_t print(const char* s) { return write((const uint8_t*)s, strlen(s)); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int v, int base = DEC) { return print((long)v, base); }
+  size_t print(unsigned v, int base = DEC) { return print((unsigned long)v, base); }
+  size_t print(long v, int base = DEC) { return format(base == HEX ? "%lx" : "%ld", v); }
+  size_t print(unsigned long v, int base = DEC) { return format(base == HEX ? "%lx" : "%lu", v); }
+  size_t print(double v, int digits = 2) { return format("%.*f", digits, v); }
+  size_t print(const IPAddress& ip) {
+    return format("%u.%u.%u.%u", ip.octets[0], ip.octets[1], ip.octets[2], ip.octets[3]);
+  }
+
+  size_t println() { return print("\n"); }
+  template <typename T> size_t println(T v) { return print(v) + println(); }
+  template <typename T> size_t println(T v, int f) { return print(v, f) + println(); }
+
+  size_t printf(const char* fmt, ...) {
+    char buf[256];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    return n > 0 ? print(buf) : 0;
+  }
+
+  size_t write(uint8_t b) { return write(&b, 1); }
+  virtual size_t write(const uint8_t* buf, size_t size) { (void)buf; return size; }
+
+ private:
+  size_t format(const char* fmt, ...) {
+    char buf[32];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    return n > 0 ? print(buf) : 0;
+  }
+};
+
+class HardwareSerial : public Print {
+ public:
+  using Print::write;
+  void begin(unsigned long) {}
+  int available() { return 0; }
+  int read() { return -1; }
+  size_t write(const uint8_t* buf, size_t size) override;
+};
+
+extern HardwareSerial Serial;
+
+struct EspClass {
+  void restart() { abort(); }
+};
+
+extern EspClass ESP;
+
+// unsigned long trên ESP32 là 32 bit: millis() tràn sau ~49 ngày. Host trả
+// uint32_t để phép trừ thời gian trong firmware tràn đúng như trên máy thật.
+uint32_t millis();
+uint32_t micros();
+void delay(unsigned long ms);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t level);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+void tone(uint8_t pin, unsigned freq, unsigned long duration = 0);
+void noTone(uint8_t pin);
+
+long random(long max);
+long map(long x, long inMin, long inMax, long outMin, long outMax);
+size_t strlcpy(char* dst, const char* src, size_t size);
+
+// FreeRTOS: mỗi task là 1 std::thread
+typedef void* TaskHandle_t;
+typedef uint32_t TickType_t;
+typedef long BaseType_t;
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+BaseType_t xTaskCreatePinnedToCore(void (*task)(void*), const char* name, uint32_t stackDepth,
+                                   void* param, unsigned priority, TaskHandle_t* handle, int core);
+void vTaskDelay(TickType_t ticks);
+TaskHandle_t xTaskGetCurrentTaskHandle();
+unsigned uxTaskGetStackHighWaterMark(TaskHandle_t task);   // Host: luôn 0
+#define configASSERT(x)  do { if (!(x)) abort(); } while (0)
+
+#endif
@@ -0,0 +1,19 @@
+// ============================================
+// LIQUIDCRYSTAL_I2C (stub host) - bỏ qua mọi thứ ghi ra LCD
+// ============================================
+#ifndef LIQUIDCRYSTAL_I2C_STUB_H
+#define LIQUIDCRYSTAL_I2C_STUB_H
+
+#include <Arduino.h>
+
+class LiquidCrystal_I2C : public Print {
+ public:
+  LiquidCrystal_I2C(uint8_t addr, uint8_t cols, uint8_t rows) { (void)addr; (void)cols; (void)rows; }
+  void init() {}
+  void clear() {}
+  void backlight() {}
+  void noBacklight() {}
+  void setCursor(uint8_t col, uint8_t row) { (void)col; (void)row; }
+};
+
+#endif
@@ -0,0 +1,73 @@
+// ============================================
+// PREFERENCES (stub host) - NVS trong RAM, mất khi thoát
+// ============================================
+#ifndef PREFERENCES_STUB_H
+#define PREFERENCES_STUB_H
+
+#include <Arduino.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "sim_board.h"
+
+class Preferences {
+ public:
+  bool begin(const char* name, bool readOnly = false) {
+    ns_ = name;
+    (void)readOnly;
+    return true;
+  }
+  void end() { ns_.clear(); }
+
+  size_t putBytes(const char* key, const void* value, size_t len) {
+    simFlashWrite();
+    const uint8_t* p = (const uint8_t*)value;
+    store()[key].assign(p, p + len);
+    return len;
+  }
+  size_t getBytes(const char* key, void* buf, size_t maxLen) {
+    const std::vector<uint8_t>* v = find(key);
+    if (v == NULL || v->size() > maxLen) return 0;
+    memcpy(buf, v->data(), v->size());
+    return v->size();
+  }
+
+  size_t putString(const char* key, const char* value) {
+    return putBytes(key, value, strlen(value) + 1) - 1;
+  }
+  size_t getString(const char* key, char* buf, size_t maxLen) {
+    size_t n = getBytes(key, buf, maxLen);
+    return n > 0 ? n - 1 : 0;
+  }
+
+  size_t putUShort(const char* key, uint16_t value) { return putBytes(key, &value, sizeof(value)); }
+  uint16_t getUShort(const char* key, uint16_t defaultValue = 0) {
+    uint16_t v;
+    return getBytes(key, &v, sizeof(v)) == sizeof(v) ? v : defaultValue;
+  }
+
+  size_t putBool(const char* key, bool value) { return putBytes(key, &value, sizeof(value)); }
+  bool getBool(const char* key, bool defaultValue = false) {
+    bool v;
+    return getBytes(key, &v, sizeof(v)) == sizeof(v) ? v : defaultValue;
+  }
+
+ private:
+  typedef std::map<std::string, std::vector<uint8_t>> Namespace;
+
+  Namespace& store() {
+    static std::map<std::string, Namespace> flash;
+    return flash[ns_];
+  }
+  const std::vector<uint8_t>* find(const char* key) {
+    Namespace& ns = store();
+    Namespace::const_iterator it = ns.find(key);
+    return it == ns.end() ? NULL : &it->second;
+  }
+
+  std::string ns_;
+};
+
+#endif
@@ -0,0 +1,86 @@
+// ============================================
+// PUBSUBCLIENT (stub host) - MQTT qua broker giả trong sim_board
+// ============================================
+#ifndef PUBSUBCLIENT_STUB_H
+#define PUBSUBCLIENT_STUB_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+#include "sim_board.h"
+
+#define MQTT_CONNECTION_TIMEOUT  -4
+#define MQTT_DISCONNECTED        -1
+#define MQTT_CONNECTED           0
+
+class PubSubClient {
+ public:
+  explicit PubSubClient(Client& client) : client_(&client) {}
+
+  PubSubClient& setClient(Client& client) {
+    client_ = &client;
+    connected_ = false;
+    return *this;
+  }
+  PubSubClient& setServer(const char* host, uint16_t port) { (void)host; (void)port; return *this; }
+  PubSubClient& setCallback(void (*callback)(char*, uint8_t*, unsigned int)) {
+    simSetCallback(callback);
+    return *this;
+  }
+  bool setBufferSize(uint16_t size) { (void)size; return true; }
+  PubSubClient& setSocketTimeout(uint16_t seconds) {
+    socketTimeout_ = seconds;
+    return *this;
+  }
+
+  // Như PubSubClient thật: gửi CONNECT rồi đứng chờ CONNACK tới socketTimeout
+  bool connect(const char* id) {
+    (void)id;
+    connected_ = false;
+    state_ = MQTT_DISCONNECTED;
+    if (!client_->connected()) return false;
+    if (!simWaitConnack(socketTimeout_ * 1000UL)) {
+      state_ = MQTT_CONNECTION_TIMEOUT;
+      client_->stop();
+      return false;
+    }
+    simClearSubscriptions();
+    connected_ = client_->connected();
+    return connected_;
+  }
+  bool connected() {
+    if (connected_ && !client_->connected()) {
+      connected_ = false;
+      simClearSubscriptions();
+    }
+    return connected_;
+  }
+  int state() { return connected() ? MQTT_CONNECTED : state_; }
+  bool loop() {
+    if (!connected()) return false;
+    simDispatch();
+    return true;
+  }
+
+  bool subscribe(const char* topic) {
+    if (!connected()) return false;
+    simSubscribe(topic);
+    return true;
+  }
+  bool publish(const char* topic, const char* payload) {
+    return publish(topic, (const uint8_t*)payload, strlen(payload));
+  }
+  bool publish(const char* topic, const uint8_t* payload, unsigned int len) {
+    if (!connected()) return false;
+    simPublish(topic, payload, len);
+    return true;
+  }
+
+ private:
+  Client* client_;
+  bool connected_ = false;
+  int state_ = MQTT_DISCONNECTED;
+  uint16_t socketTimeout_ = 15;   // Mặc định của PubSubClient
+};
+
+#endif
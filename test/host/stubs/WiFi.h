@@ -0,0 +1,68 @@
+// ============================================
+// WIFI (stub host) - WiFi luôn lên, socket nối tới broker giả trong sim_board
+// ============================================
+#ifndef WIFI_STUB_H
+#define WIFI_STUB_H
+
+#include <Arduino.h>
+
+#include "sim_board.h"
+
+#define WL_CONNECTED  3
+#define WIFI_STA      1
+
+class Client : public Print {
+ public:
+  virtual int connect(IPAddress ip, uint16_t port) = 0;
+  virtual int connect(const char* host, uint16_t port) = 0;
+  virtual size_t write(uint8_t b) = 0;
+  virtual size_t write(const uint8_t* buf, size_t size) = 0;
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int read(uint8_t* buf, size_t size) = 0;
+  virtual int peek() = 0;
+  virtual void flush() = 0;
+  virtual void stop() = 0;
+  virtual uint8_t connected() = 0;
+  virtual operator bool() = 0;
+};
+
+// Không mang byte thật: PubSubClient stub publish/nhận message thẳng qua sim_board
+class WiFiClient : public Client {
+ public:
+  int connect(IPAddress ip, uint16_t port) override { (void)ip; return connect("", port); }
+  int connect(const char* host, uint16_t port) override {
+    (void)host;
+    (void)port;
+    socket_ = simSocketOpen();
+    return socket_ != 0;
+  }
+  size_t write(uint8_t b) override { return write(&b, 1); }
+  size_t write(const uint8_t* buf, size_t size) override { (void)buf; return connected() ? size : 0; }
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int read(uint8_t* buf, size_t size) override { (void)buf; (void)size; return -1; }
+  int peek() override { return -1; }
+  void flush() override {}
+  void stop() override { socket_ = 0; }
+  uint8_t connected() override { return simSocketAlive(socket_); }
+  operator bool() override { return connected(); }
+
+  int setNoDelay(bool on) { (void)on; return 0; }
+
+ private:
+  unsigned long socket_ = 0;
+};
+
+class WiFiClass {
+ public:
+  void mode(int m) { (void)m; }
+  void setAutoReconnect(bool on) { (void)on; }
+  int begin(const char* ssid, const char* password) { (void)ssid; (void)password; return WL_CONNECTED; }
+  int status() { return WL_CONNECTED; }
+  IPAddress localIP() { return IPAddress{{10, 0, 0, 2}}; }
+};
+
+extern WiFiClass WiFi;
+
+#endif
@@ -0,0 +1,17 @@
+// ============================================
+// WIRE (stub host)
+// ============================================
+#ifndef WIRE_STUB_H
+#define WIRE_STUB_H
+
+#include <Arduino.h>
+
+class TwoWire {
+ public:
+  bool begin(int sda, int scl) { (void)sda; (void)scl; return true; }
+  void setClock(uint32_t hz) { (void)hz; }
+};
+
+extern TwoWire Wire;
+
+#endif
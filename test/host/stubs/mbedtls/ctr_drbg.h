@@ -0,0 +1,11 @@
+// mbedtls 2.x (stub host): chỉ khai báo phần broker_transport.cpp dùng
+#ifndef MBEDTLS_CTR_DRBG_STUB_H
+#define MBEDTLS_CTR_DRBG_STUB_H
+
+#include <stddef.h>
+typedef struct { int x; } mbedtls_ctr_drbg_context;
+void mbedtls_ctr_drbg_init(mbedtls_ctr_drbg_context*);
+int mbedtls_ctr_drbg_seed(mbedtls_ctr_drbg_context*, int (*)(void*, unsigned char*, size_t), void*, const unsigned char*, size_t);
+int mbedtls_ctr_drbg_random(void*, unsigned char*, size_t);
+
+#endif
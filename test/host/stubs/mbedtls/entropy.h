@@ -0,0 +1,10 @@
+// mbedtls 2.x (stub host): chỉ khai báo phần broker_transport.cpp dùng
+#ifndef MBEDTLS_ENTROPY_STUB_H
+#define MBEDTLS_ENTROPY_STUB_H
+
+#include <stddef.h>
+typedef struct { int x; } mbedtls_entropy_context;
+void mbedtls_entropy_init(mbedtls_entropy_context*);
+int mbedtls_entropy_func(void*, unsigned char*, size_t);
+
+#endif
@@ -0,0 +1,7 @@
+// mbedtls 2.x (stub host): chỉ khai báo phần broker_transport.cpp dùng
+#ifndef MBEDTLS_NET_SOCKETS_STUB_H
+#define MBEDTLS_NET_SOCKETS_STUB_H
+
+#define MBEDTLS_ERR_NET_CONN_RESET -0x0050
+
+#endif
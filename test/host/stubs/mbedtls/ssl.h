@@ -0,0 +1,52 @@
+// mbedtls 2.x (stub host): chỉ khai báo phần broker_transport.cpp dùng
+#ifndef MBEDTLS_SSL_STUB_H
+#define MBEDTLS_SSL_STUB_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "x509_crt.h"
+#define MBEDTLS_ERR_SSL_WANT_READ -0x6900
+#define MBEDTLS_ERR_SSL_WANT_WRITE -0x6880
+#define MBEDTLS_SSL_IS_CLIENT 0
+#define MBEDTLS_SSL_TRANSPORT_STREAM 0
+#define MBEDTLS_SSL_PRESET_DEFAULT 0
+#define MBEDTLS_SSL_VERIFY_REQUIRED 2
+#define MBEDTLS_SSL_MAJOR_VERSION_3 3
+#define MBEDTLS_SSL_MINOR_VERSION_3 3
+#define MBEDTLS_SSL_SESSION_TICKETS_ENABLED 1
+#define MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256 0xC02B
+typedef enum { MBEDTLS_ECP_DP_NONE = 0, MBEDTLS_ECP_DP_SECP256R1 } mbedtls_ecp_group_id;
+typedef struct { int x; } mbedtls_ssl_context;
+typedef struct { int x; } mbedtls_ssl_config;
+typedef struct { int x; } mbedtls_ssl_session;
+typedef int mbedtls_ssl_send_t(void*, const unsigned char*, size_t);
+typedef int mbedtls_ssl_recv_t(void*, unsigned char*, size_t);
+typedef int mbedtls_ssl_recv_timeout_t(void*, unsigned char*, size_t, uint32_t);
+void mbedtls_ssl_init(mbedtls_ssl_context*);
+int mbedtls_ssl_setup(mbedtls_ssl_context*, const mbedtls_ssl_config*);
+int mbedtls_ssl_set_hostname(mbedtls_ssl_context*, const char*);
+int mbedtls_ssl_set_session(mbedtls_ssl_context*, const mbedtls_ssl_session*);
+int mbedtls_ssl_get_session(const mbedtls_ssl_context*, mbedtls_ssl_session*);
+void mbedtls_ssl_set_verify(mbedtls_ssl_context*, int (*)(void*, mbedtls_x509_crt*, int, uint32_t*), void*);
+void mbedtls_ssl_set_bio(mbedtls_ssl_context*, void*, mbedtls_ssl_send_t*, mbedtls_ssl_recv_t*, mbedtls_ssl_recv_timeout_t*);
+int mbedtls_ssl_handshake(mbedtls_ssl_context*);
+uint32_t mbedtls_ssl_get_verify_result(const mbedtls_ssl_context*);
+int mbedtls_ssl_write(mbedtls_ssl_context*, const unsigned char*, size_t);
+int mbedtls_ssl_read(mbedtls_ssl_context*, unsigned char*, size_t);
+size_t mbedtls_ssl_get_bytes_avail(const mbedtls_ssl_context*);
+int mbedtls_ssl_close_notify(mbedtls_ssl_context*);
+void mbedtls_ssl_free(mbedtls_ssl_context*);
+void mbedtls_ssl_session_init(mbedtls_ssl_session*);
+void mbedtls_ssl_session_free(mbedtls_ssl_session*);
+void mbedtls_ssl_config_init(mbedtls_ssl_config*);
+int mbedtls_ssl_config_defaults(mbedtls_ssl_config*, int, int, int);
+void mbedtls_ssl_conf_authmode(mbedtls_ssl_config*, int);
+void mbedtls_ssl_conf_ca_chain(mbedtls_ssl_config*, mbedtls_x509_crt*, void*);
+void mbedtls_ssl_conf_rng(mbedtls_ssl_config*, int (*)(void*, unsigned char*, size_t), void*);
+void mbedtls_ssl_conf_min_version(mbedtls_ssl_config*, int, int);
+void mbedtls_ssl_conf_max_version(mbedtls_ssl_config*, int, int);
+void mbedtls_ssl_conf_ciphersuites(mbedtls_ssl_config*, const int*);
+void mbedtls_ssl_conf_curves(mbedtls_ssl_config*, const mbedtls_ecp_group_id*);
+void mbedtls_ssl_conf_session_tickets(mbedtls_ssl_config*, int);
+
+#endif
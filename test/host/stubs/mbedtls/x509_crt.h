@@ -0,0 +1,10 @@
+// mbedtls 2.x (stub host): chỉ khai báo phần broker_transport.cpp dùng
+#ifndef MBEDTLS_X509_CRT_STUB_H
+#define MBEDTLS_X509_CRT_STUB_H
+
+#include <stddef.h>
+typedef struct { int x; } mbedtls_x509_crt;
+void mbedtls_x509_crt_init(mbedtls_x509_crt*);
+int mbedtls_x509_crt_parse(mbedtls_x509_crt*, const unsigned char*, size_t);
+
+#endif
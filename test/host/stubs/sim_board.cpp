@@ -0,0 +1,317 @@
+// ============================================
+// SIM BOARD - xem sim_board.h
+// ============================================
+#include "sim_board.h"
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <Wire.h>
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <thread>
+
+HardwareSerial Serial;
+TwoWire Wire;
+WiFiClass WiFi;
+EspClass ESP;
+
+// ============================================
+// ĐỒNG HỒ
+// ============================================
+// mqttConnectTask chạy trên thread riêng và cũng đọc millis()
+static std::atomic<unsigned long> simNow(1000);
+static std::atomic<unsigned long> clockOffset(0);
+
+unsigned long simRawMillis() {
+  return simNow;
+}
+
+void simSetClockOffset(unsigned long offset) {
+  clockOffset = offset;
+}
+
+uint32_t millis() {
+  return (uint32_t)(simNow + clockOffset);
+}
+
+uint32_t micros() {
+  return millis() * 1000u;
+}
+
+// Nhường CPU cho task nền: kết nối broker xong trong vài vòng loop như máy thật
+void delay(unsigned long ms) {
+  simNow += ms;
+  std::this_thread::sleep_for(std::chrono::microseconds(50));
+}
+
+// Thread của task FreeRTOS (không phải thread chạy setup()/loop())
+static thread_local bool onTaskThread = false;
+
+BaseType_t xTaskCreatePinnedToCore(void (*task)(void*), const char* name, uint32_t stackDepth,
+                                   void* param, unsigned priority, TaskHandle_t* handle, int core) {
+  (void)name;
+  (void)stackDepth;
+  (void)priority;
+  (void)core;
+  std::thread([task, param] {
+    onTaskThread = true;
+    task(param);
+  }).detach();
+  if (handle != NULL) *handle = NULL;
+  return 1;
+}
+
+void vTaskDelay(TickType_t ticks) {
+  (void)ticks;
+  std::this_thread::sleep_for(std::chrono::microseconds(200));
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+  static thread_local char task;
+  return &task;
+}
+
+unsigned uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+  (void)task;
+  return 0;
+}
+
+// ============================================
+// GPIO
+// ============================================
+#define SIM_PIN_COUNT  40
+
+static int outputLevel[SIM_PIN_COUNT];
+static int inputLevel[SIM_PIN_COUNT];
+static bool inputSet[SIM_PIN_COUNT];
+static int analogValue[SIM_PIN_COUNT];
+static int analogSpikes[SIM_PIN_COUNT];
+static uint32_t noiseState = 12345;
+static void (*analogReadHook)(uint8_t) = NULL;
+
+void simSetInput(uint8_t pin, int level) {
+  inputLevel[pin] = level;
+  inputSet[pin] = true;
+}
+
+void simSetAnalog(uint8_t pin, int value) {
+  analogValue[pin] = value;
+}
+
+void simSetAnalogSpikes(uint8_t pin, int percent) {
+  analogSpikes[pin] = percent;
+}
+
+int simPinLevel(uint8_t pin) {
+  return outputLevel[pin];
+}
+
+void simSetAnalogReadHook(void (*hook)(uint8_t pin)) {
+  analogReadHook = hook;
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  (void)pin;
+  (void)mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t level) {
+  outputLevel[pin] = level;
+}
+
+int digitalRead(uint8_t pin) {
+  return inputSet[pin] ? inputLevel[pin] : HIGH;
+}
+
+int analogRead(uint8_t pin) {
+  if (analogReadHook != NULL) analogReadHook(pin);
+  if (analogSpikes[pin] > 0) {
+    noiseState = noiseState * 1103515245u + 12345u;   // LCG: cùng chuỗi spike mỗi lần chạy
+    if ((int)((noiseState >> 16) % 100) < analogSpikes[pin]) return 4095;
+  }
+  return analogValue[pin];
+}
+
+void tone(uint8_t pin, unsigned freq, unsigned long duration) {
+  (void)pin;
+  (void)freq;
+  (void)duration;
+}
+
+void noTone(uint8_t pin) {
+  (void)pin;
+}
+
+long random(long max) {
+  return max > 0 ? rand() % max : 0;
+}
+
+long map(long x, long inMin, long inMax, long outMin, long outMax) {
+  return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+size_t strlcpy(char* dst, const char* src, size_t size) {
+  size_t len = strlen(src);
+  if (size > 0) {
+    size_t n = len < size - 1 ? len : size - 1;
+    memcpy(dst, src, n);
+    dst[n] = '\0';
+  }
+  return len;
+}
+
+// ============================================
+// NVS
+// ============================================
+static void (*flashWriteHook)() = NULL;
+
+void simSetFlashWriteHook(void (*hook)()) {
+  flashWriteHook = hook;
+}
+
+void simFlashWrite() {
+  if (flashWriteHook != NULL) flashWriteHook();
+}
+
+// ============================================
+// SERIAL
+// ============================================
+static bool verbose = false;
+
+void simSetVerbose(bool on) {
+  verbose = on;
+}
+
+size_t HardwareSerial::write(const uint8_t* buf, size_t size) {
+  if (verbose) fwrite(buf, 1, size, stdout);
+  return size;
+}
+
+// ============================================
+// BROKER
+// ============================================
+// Socket là số thứ tự; drop = mọi số <= droppedUpTo coi như đã đóng
+static std::atomic<bool> brokerUp(true);
+static std::atomic<unsigned long> lastSocket(0);
+static std::atomic<unsigned long> droppedUpTo(0);
+
+static std::atomic<unsigned long> connackDelayMs(0);
+static std::atomic<int> connackWaiting(0);
+
+static void (*mqttCallback)(char*, uint8_t*, unsigned int) = NULL;
+// connect() (xoá subscription) chạy trên mqttConnectTask, phần còn lại trên loop
+static std::mutex subscriptionsMutex;
+static std::set<std::string> subscriptions;
+static std::deque<SimMessage> inbox;
+static std::vector<SimMessage> published;
+static unsigned long dispatchMaxUs = 0;
+
+void simSetBrokerUp(bool up) {
+  brokerUp = up;
+}
+
+void simDropConnections() {
+  droppedUpTo = lastSocket.load();
+}
+
+unsigned long simSocketOpen() {
+  if (!brokerUp) return 0;
+  return ++lastSocket;
+}
+
+bool simSocketAlive(unsigned long socket) {
+  return socket != 0 && socket > droppedUpTo;
+}
+
+void simSetConnackDelay(unsigned long ms) {
+  connackDelayMs = ms;
+}
+
+bool simConnackPending() {
+  return connackWaiting > 0;
+}
+
+// Gọi từ loop thread: chính lần chờ này làm loop() đứng, đồng hồ nhảy theo.
+// Gọi từ task: loop vẫn chạy và đẩy đồng hồ, task chỉ ngủ chờ.
+bool simWaitConnack(unsigned long timeoutMs) {
+  unsigned long wait = min(connackDelayMs.load(), timeoutMs);
+  connackWaiting++;
+  if (onTaskThread) {
+    unsigned long due = simRawMillis() + wait;
+    while (simRawMillis() < due) std::this_thread::sleep_for(std::chrono::microseconds(50));
+  } else {
+    delay(wait);
+  }
+  connackWaiting--;
+  return connackDelayMs < timeoutMs;
+}
+
+void simSetCallback(void (*callback)(char*, uint8_t*, unsigned int)) {
+  mqttCallback = callback;
+}
+
+void simSubscribe(const char* topic) {
+  std::lock_guard<std::mutex> lock(subscriptionsMutex);
+  subscriptions.insert(topic);
+}
+
+void simClearSubscriptions() {
+  std::lock_guard<std::mutex> lock(subscriptionsMutex);
+  subscriptions.clear();
+}
+
+bool simSubscribed(const char* topic) {
+  std::lock_guard<std::mutex> lock(subscriptionsMutex);
+  return subscriptions.count(topic) > 0;
+}
+
+bool simDeliver(const char* topic, const char* payload, size_t len) {
+  if (!simSubscribed(topic)) return false;
+  SimMessage msg;
+  msg.topic = topic;
+  msg.payload.assign(payload, len);
+  msg.at = simRawMillis();
+  inbox.push_back(msg);
+  return true;
+}
+
+void simDispatch() {
+  dispatchMaxUs = 0;
+  while (!inbox.empty()) {
+    SimMessage msg = inbox.front();
+    inbox.pop_front();
+    if (mqttCallback == NULL || !simSubscribed(msg.topic.c_str())) continue;
+
+    // PubSubClient đưa topic + payload trong buffer của nó, firmware parse tại chỗ
+    std::vector<char> topic(msg.topic.begin(), msg.topic.end());
+    topic.push_back('\0');
+    std::vector<uint8_t> payload(msg.payload.begin(), msg.payload.end());
+    payload.push_back('\0');
+
+    std::chrono::steady_clock::time_point t = std::chrono::steady_clock::now();
+    mqttCallback(topic.data(), payload.data(), (unsigned int)msg.payload.size());
+    unsigned long us = (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - t).count();
+    dispatchMaxUs = max(dispatchMaxUs, us);
+  }
+}
+
+unsigned long simDispatchMaxUs() {
+  return dispatchMaxUs;
+}
+
+void simPublish(const char* topic, const uint8_t* payload, size_t len) {
+  SimMessage msg;
+  msg.topic = topic;
+  msg.payload.assign((const char*)payload, len);
+  msg.at = simRawMillis();
+  published.push_back(msg);
+}
+
+const std::vector<SimMessage>& simPublished() {
+  return published;
+}
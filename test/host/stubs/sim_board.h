@@ -0,0 +1,65 @@
+// ============================================
+// SIM BOARD
+// Phần cứng và broker giả cho build host. Các stub Arduino/WiFi/PubSubClient
+// đọc/ghi trạng thái ở đây; kịch bản điều khiển qua các hàm sim*().
+// Đồng hồ chỉ tiến khi firmware gọi delay(): chạy nhanh hơn thời gian thật và
+// lặp lại được.
+// ============================================
+#ifndef SIM_BOARD_H
+#define SIM_BOARD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+// Đồng hồ: millis() = (simRawMillis() + offset) mod 2^32 như trên ESP32.
+// simRawMillis() không tràn, kịch bản đo thời gian bằng nó.
+unsigned long simRawMillis();
+void simSetClockOffset(unsigned long offset);
+
+// GPIO. Chân input chưa đặt đọc HIGH (INPUT_PULLUP).
+void simSetInput(uint8_t pin, int level);
+void simSetAnalog(uint8_t pin, int value);
+// Tỉ lệ (%) lần analogRead() trả 4095 thay vì giá trị thật, chuỗi giả ngẫu nhiên cố định
+void simSetAnalogSpikes(uint8_t pin, int percent);
+int simPinLevel(uint8_t pin);   // Mức digitalWrite() gần nhất
+// Gọi trước mỗi analogRead() của firmware (NULL = tắt)
+void simSetAnalogReadHook(void (*hook)(uint8_t pin));
+// Gọi mỗi lần firmware ghi NVS (Preferences::put*)
+void simSetFlashWriteHook(void (*hook)());
+
+// Broker
+struct SimMessage {
+  std::string topic;
+  std::string payload;
+  unsigned long at;             // simRawMillis()
+};
+
+void simSetBrokerUp(bool up);   // false: connect() mới thất bại
+void simDropConnections();      // Đóng mọi socket đang mở
+void simSetConnackDelay(unsigned long ms);   // Broker trả CONNACK sau ms (0 = ngay)
+bool simConnackPending();       // Có connect() đang chờ CONNACK
+bool simSubscribed(const char* topic);
+// Xếp message cho firmware như broker gửi xuống; callback chạy trong mqtt.loop()
+// kế tiếp. False nếu firmware không subscribe topic (QoS 0: broker bỏ luôn).
+bool simDeliver(const char* topic, const char* payload, size_t len);
+unsigned long simDispatchMaxUs();   // Callback lâu nhất (µs thật) của lần dispatch gần nhất
+const std::vector<SimMessage>& simPublished();
+
+void simSetVerbose(bool on);    // In Serial của firmware ra stdout
+
+// Dùng bởi stub
+unsigned long simSocketOpen();  // 0 nếu broker không nhận kết nối
+bool simSocketAlive(unsigned long socket);
+// False nếu CONNACK không tới trong timeoutMs (PubSubClient: MQTT_CONNECTION_TIMEOUT)
+bool simWaitConnack(unsigned long timeoutMs);
+void simFlashWrite();
+void simSetCallback(void (*callback)(char*, uint8_t*, unsigned int));
+void simSubscribe(const char* topic);
+void simClearSubscriptions();
+void simDispatch();
+void simPublish(const char* topic, const uint8_t* payload, size_t len);
+
+#endif
@@ -0,0 +1,95 @@
+// ============================================
+// TELEMETRY FRAME DECODER - xem telemetry_frame.h
+// ============================================
+#include "telemetry_frame.h"
+
+#include "laundry_protocol.h"
+#include "machine_config.h"
+
+#define ADC_MAX  4095
+
+namespace {
+
+struct Reader {
+  const uint8_t* data;
+  size_t len;
+  size_t pos;
+
+  bool byte(uint8_t* out) {
+    if (pos >= len) return false;
+    *out = data[pos++];
+    return true;
+  }
+
+  // uint32 tối đa 5 byte; byte thứ 5 chỉ còn 4 bit
+  bool varint(uint32_t* out) {
+    uint32_t value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+      uint8_t b;
+      if (!byte(&b)) return false;
+      if (shift == 28 && b > 0x0F) return false;
+      value |= (uint32_t)(b & 0x7F) << shift;
+      if ((b & 0x80) == 0) {
+        *out = value;
+        return true;
+      }
+    }
+    return false;
+  }
+};
+
+bool fail(std::string* error, const char* message) {
+  if (error != NULL) *error = message;
+  return false;
+}
+
+}  // namespace
+
+bool decodeTelemetryFrame(const std::string& payload, TelemetryFrame* frame, std::string* error) {
+  const uint8_t* p = (const uint8_t*)payload.data();
+  if (payload.size() < TELEMETRY_HEADER_BYTES) return fail(error, "short header");
+
+  frame->version = p[0];
+  frame->seq = p[1] | (p[2] << 8);
+  frame->t0 = (uint32_t)p[3] | ((uint32_t)p[4] << 8) | ((uint32_t)p[5] << 16) | ((uint32_t)p[6] << 24);
+  frame->sampleMs = p[7] | (p[8] << 8);
+  uint8_t count = p[9];
+  frame->samples.clear();
+
+  if (frame->version != TELEMETRY_VERSION) return fail(error, "version");
+  if (frame->sampleMs == 0) return fail(error, "sample period 0");
+  if (count == 0 || count > TELEMETRY_MAX_SAMPLES) return fail(error, "sample count");
+
+  Reader in = { p, payload.size(), TELEMETRY_HEADER_BYTES };
+  int water = 0;
+  int dirt = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    TelemetrySample s;
+    s.t = frame->t0 + (uint32_t)i * frame->sampleMs;
+    if (!in.byte(&s.flags)) return fail(error, "truncated flags");
+
+    uint8_t b0, b1;
+    if (i == 0) {
+      if (!in.byte(&b0) || !in.byte(&b1)) return fail(error, "truncated first sample");
+      water = b0;
+      if (!in.byte(&b0)) return fail(error, "truncated first sample");
+      dirt = b1 | (b0 << 8);
+    } else {
+      uint32_t zigzag;
+      if (!in.byte(&b0)) return fail(error, "truncated dWater");
+      if (!in.varint(&zigzag)) return fail(error, "bad dDirt varint");
+      water += (int8_t)b0;
+      dirt += (int32_t)((zigzag >> 1) ^ (0u - (zigzag & 1)));
+    }
+
+    if ((s.flags >> TELEMETRY_STATE_SHIFT) >= STATE_COUNT) return fail(error, "state out of range");
+    if (water < 0 || water > 100) return fail(error, "water out of range");
+    if (dirt < 0 || dirt > ADC_MAX) return fail(error, "dirt out of range");
+    s.water = water;
+    s.dirt = dirt;
+    frame->samples.push_back(s);
+  }
+
+  if (in.pos != in.len) return fail(error, "trailing bytes");
+  return true;
+}
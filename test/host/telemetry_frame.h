@@ -0,0 +1,34 @@
+// ============================================
+// TELEMETRY FRAME DECODER
+// Giải frame nhị phân trên LAUNDRY_TOPIC_TELEMETRY như phía server, để kịch bản
+// so từng mẫu với mô phỏng. Định dạng: phần TELEMETRY FRAMES trong src/main.cpp.
+// ============================================
+#ifndef TELEMETRY_FRAME_H
+#define TELEMETRY_FRAME_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+struct TelemetrySample {
+  uint32_t t;                   // millis() của firmware: t0 + i * sampleMs
+  uint8_t flags;
+  int water;                    // 0-100
+  int dirt;                     // ADC thô
+};
+
+struct TelemetryFrame {
+  uint8_t version;
+  uint16_t seq;
+  uint32_t t0;
+  uint16_t sampleMs;
+  std::vector<TelemetrySample> samples;
+};
+
+// False + error nếu frame sai version, sai số mẫu, varint dở dang, giá trị
+// ngoài khoảng hoặc thừa/thiếu byte so với số mẫu khai trong header
+bool decodeTelemetryFrame(const std::string& payload, TelemetryFrame* frame, std::string* error);
+
+#endif
@@ -0,0 +1,39 @@
+#!/bin/sh
+# Sinh CA + chứng chỉ server ECDSA P-256 cho broker TLS cục bộ (mosquitto.conf).
+# Usage: ./gen_certs.sh <host|ip> [host|ip ...]
+#   Tên đầu tiên là CN, tất cả đều vào subjectAltName. Máy giặt kiểm tra
+#   hostname theo đúng chuỗi cấu hình bằng lệnh 'broker' trên Serial console.
+set -e
+cd "$(dirname "$0")"
+
+if [ $# -lt 1 ]; then
+  echo "Usage: $0 <host|ip> [host|ip ...]" >&2
+  exit 1
+fi
+
+san=""
+for h in "$@"; do
+  case "$h" in
+    *[!0-9.]*) entry="DNS:$h" ;;
+    *)         entry="IP:$h" ;;
+  esac
+  san="${san:+$san,}$entry"
+done
+
+mkdir -p certs
+openssl ecparam -name prime256v1 -genkey -noout -out certs/ca.key
+openssl req -x509 -new -key certs/ca.key -sha256 -days 3650 \
+  -subj "/CN=Laundry Test CA" -out certs/ca.pem
+openssl ecparam -name prime256v1 -genkey -noout -out certs/server.key
+openssl req -new -key certs/server.key -subj "/CN=$1" -out certs/server.csr
+printf "subjectAltName=%s\nextendedKeyUsage=serverAuth\n" "$san" > certs/server.ext
+openssl x509 -req -in certs/server.csr -CA certs/ca.pem -CAkey certs/ca.key \
+  -CAcreateserial -days 825 -sha256 -extfile certs/server.ext -out certs/server.pem
+rm -f certs/server.csr certs/server.ext certs/ca.srl
+
+echo
+echo "Serial console của máy giặt:"
+echo "  broker $1 8883 tls"
+echo "  ca"
+cat certs/ca.pem
+echo "  reboot"
@@ -0,0 +1,98 @@
+#!/usr/bin/env python3
+"""Đo thời gian kết nối tới broker TLS: handshake đầy đủ và handshake resume.
+
+Mỗi lần đo: TCP connect -> TLS handshake -> (tuỳ chọn) MQTT CONNECT/CONNACK -> đóng.
+Cùng cấu hình TLS với firmware (TLS 1.2, ECDHE-ECDSA-AES128-GCM-SHA256), nên
+dùng để kiểm tra broker có resume session không và so sánh với số đo mà máy
+giặt in ra sau mỗi lần kết nối ("Connected! tcp=.. tls=.. (full|resumed)").
+
+    python3 measure_tls.py 192.168.1.10 --cafile certs/ca.pem --mqtt
+"""
+import argparse
+import socket
+import ssl
+import statistics
+import time
+
+CIPHERS = "ECDHE-ECDSA-AES128-GCM-SHA256"
+
+
+def mqtt_connect_packet(client_id):
+    cid = client_id.encode()
+    variable = b"\x00\x04MQTT\x04\x02\x00\x3c"   # MQTT 3.1.1, clean session, keepalive 60s
+    payload = len(cid).to_bytes(2, "big") + cid
+    remaining = len(variable) + len(payload)
+    return bytes([0x10, remaining]) + variable + payload
+
+
+def read_exact(sock, n):
+    data = b""
+    while len(data) < n:
+        chunk = sock.recv(n - len(data))
+        if not chunk:
+            raise ConnectionError("broker closed connection")
+        data += chunk
+    return data
+
+
+def connect_once(args, ctx, session):
+    t0 = time.perf_counter()
+    raw = socket.create_connection((args.host, args.port), timeout=10)
+    raw.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+    t1 = time.perf_counter()
+    sock = ctx.wrap_socket(raw, server_hostname=args.host, session=session)
+    t2 = time.perf_counter()
+    if args.mqtt:
+        sock.sendall(mqtt_connect_packet("measure_tls"))
+        connack = read_exact(sock, 4)
+        if connack[0] != 0x20 or connack[3] != 0:
+            raise ConnectionError("CONNACK refused: %r" % connack)
+    t3 = time.perf_counter()
+    result = {
+        "tcp": (t1 - t0) * 1000,
+        "tls": (t2 - t1) * 1000,
+        "total": (t3 - t0) * 1000,
+        "reused": sock.session_reused,
+        "session": sock.session,
+    }
+    sock.close()
+    return result
+
+
+def summarize(name, runs):
+    print("%-8s n=%-3d reused=%d/%d" % (name, len(runs), sum(r["reused"] for r in runs), len(runs)))
+    for key in ("tcp", "tls", "total"):
+        values = sorted(r[key] for r in runs)
+        p95 = values[min(len(values) - 1, int(len(values) * 0.95))]
+        print("  %-5s median=%7.2f ms  p95=%7.2f ms" % (key, statistics.median(values), p95))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("host")
+    parser.add_argument("--port", type=int, default=8883)
+    parser.add_argument("--cafile", default="certs/ca.pem")
+    parser.add_argument("--count", type=int, default=50)
+    parser.add_argument("--mqtt", action="store_true", help="gửi MQTT CONNECT, đo tới CONNACK")
+    args = parser.parse_args()
+
+    ctx = ssl.create_default_context(cafile=args.cafile)
+    ctx.minimum_version = ssl.TLSVersion.TLSv1_2
+    ctx.maximum_version = ssl.TLSVersion.TLSv1_2
+    ctx.set_ciphers(CIPHERS)
+
+    full = [connect_once(args, ctx, None) for _ in range(args.count)]
+
+    session = full[-1]["session"]
+    resumed = []
+    for _ in range(args.count):
+        run = connect_once(args, ctx, session)
+        session = run["session"]
+        resumed.append(run)
+
+    summarize("full", full)
+    summarize("resumed", resumed)
+
+
+if __name__ == "__main__":
+    main()
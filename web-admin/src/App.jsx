@@ -9,7 +9,16 @@ import Login from './pages/Login';
 import Layout from './components/Layout';
 
 const API_URL = import.meta.env.VITE_API_URL || 'http://localhost:5000';
-const socket = io(API_URL);
+// Token đọc lại mỗi lần (re)connect: server chỉ nhận lệnh từ socket đã đăng nhập
+const socket = io(API_URL, {
+  auth: (cb) => cb({ token: localStorage.getItem('token') })
+});
+
+// Kết nối lại để handshake mang token mới (đăng nhập/đăng xuất)
+const reconnectSocket = () => {
+  socket.disconnect();
+  socket.connect();
+};
 
 // Set axios defaults
 axios.defaults.baseURL = API_URL;
@@ -89,6 +98,7 @@ function App() {
 
   const handleLogin = (adminData) => {
     setAdmin(adminData);
+    reconnectSocket();
   };
 
   const handleLogout = () => {
@@ -96,6 +106,7 @@ function App() {
     localStorage.removeItem('admin');
     delete axios.defaults.headers.common['Authorization'];
     setAdmin(null);
+    reconnectSocket();
   };
 
   if (authLoading) {